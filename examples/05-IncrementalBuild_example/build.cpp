@@ -61,6 +61,10 @@ int main(int argc, char **argv)
     // Add argument that would be passed to executable, when runned.
     cmd.add_run_argument("test123");
 
+    // "./build --watch" rebuilds and runs executable every time source or header is saved
+    if (is_argument_set("--watch", argc, argv))
+        return cmd.watch_build(true) ? EXIT_SUCCESS : EXIT_FAILURE;
+
     bool run = true;
     if (!cmd.end_build(run, force_rebuilt))
         return EXIT_FAILURE;
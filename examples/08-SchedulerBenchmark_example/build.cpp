@@ -0,0 +1,129 @@
+// Benchmark of compile job scheduling on a synthetic project with mixed-duration translation units.
+// It compiles the same files through a Processes pool in two ways:
+//   batch  - fill every slot, then wait for the whole batch to finish (wait_all)
+//   window - start next compile as soon as any job exits (wait_any), that's what Cmd::end_build does
+// Utilization = sum of job durations / (wall time * slots)
+//
+// Usage: ./build [slots] (by default it's number of processors)
+#define EZBUILD_IMPLEMENTATION
+#include "../../ezbuild.hpp"
+
+using namespace Sl;
+
+static const int  NUMBER_OF_FILES  = 32;
+static const int  HEAVY_FILE_EVERY = 8;   // Every 8th file is slow to compile
+static const int  HEAVY_FILE_WORK  = 60;  // Bigger = slower heavy files
+static const char SYNTHETIC_FOLDER[] = ".synthetic";
+
+struct Job
+{
+    ProcessID id;
+    u64 start_time;
+};
+
+static bool generate_project(Array<StrView>& sources_out)
+{
+    create_folder(SYNTHETIC_FOLDER);
+    for (int i = 0; i < NUMBER_OF_FILES; ++i) {
+        StrBuilder path(get_global_allocator());
+        path.appendf("%s/file%d.cpp", SYNTHETIC_FOLDER, i);
+        path.append_null(false);
+
+        StrBuilder source(get_global_allocator());
+        if (i % HEAVY_FILE_EVERY == 0) {
+            source.appendf("template<int Tag, int N> struct Sum { static constexpr long long value = N + Sum<Tag, N - 1>::value; };\n");
+            source.appendf("template<int Tag> struct Sum<Tag, 0> { static constexpr long long value = 0; };\n");
+            source.appendf("template<int... Tags> constexpr long long sum_all() { return (Sum<Tags, 800>::value + ...); }\n");
+            source.appendf("long long heavy%d() { return sum_all<", i);
+            for (int tag = 0; tag < HEAVY_FILE_WORK; ++tag)
+                source.appendf(tag == 0 ? "%d" : ", %d", tag);
+            source.appendf(">(); }\n");
+        } else {
+            source.appendf("int light%d(int x) { return x * %d; }\n", i, i);
+        }
+        if (!write_to_file(path.to_string_view(true), source.data(), source.count()))
+            return false;
+        sources_out.push(path.to_string_view(true));
+    }
+    return true;
+}
+
+static void push_compile_command(Cmd& cmd, StrView source)
+{
+    const auto compiler = get_compiler();
+    cmd.reset();
+    if (compiler == FlagsCompiler::MSVC)
+        cmd.push(get_compiler_name(compiler), "/nologo", "/std:c++17", "/c", source, "/Fo:");
+    else
+        cmd.push(get_compiler_name(compiler), "-std=c++17", "-c", source, "-o");
+    cmd.append(source);
+    cmd.append(".obj");
+}
+
+// Returns wall time in microseconds, busy_time_out is sum of all job durations
+static u64 run_jobs(Array<StrView>& sources, usize slots, bool sliding_window, u64& busy_time_out)
+{
+    Processes procs = {};
+    Array<Job> jobs = {};
+    Cmd cmd = {};
+    CmdOptions options = {};
+    options.print_command = false;
+    options.async = &procs;
+
+    busy_time_out = 0;
+    auto finish_one = [&]() {
+        Process finished;
+        procs.wait_any(&finished);
+        const auto now = get_monotonic_time();
+        for (usize i = 0; i < jobs.count(); ++i) {
+            if (jobs[i].id == finished.id) {
+                busy_time_out += now - jobs[i].start_time;
+                jobs.remove_unordered(i);
+                break;
+            }
+        }
+    };
+
+    const auto start = get_monotonic_time();
+    for (auto& source : sources) {
+        if (procs.count() >= slots) {
+            if (sliding_window) {
+                finish_one();
+            } else {
+                while (procs.count() > 0) finish_one();
+            }
+        }
+        push_compile_command(cmd, source);
+        auto proc = cmd.execute(options);
+        jobs.push(Job{proc.id, get_monotonic_time()});
+    }
+    while (procs.count() > 0) finish_one();
+    const auto wall_time = get_monotonic_time() - start;
+
+    jobs.cleanup();
+    return wall_time;
+}
+
+int main(int argc, char **argv)
+{
+    rebuild_itself(ExecutableOptions{}, argc, argv, "../../ezbuild.hpp");
+    ScopedLogger _(logger_colored);
+
+    usize slots = get_system_info().number_of_processors;
+    if (argc > 1 && atoi(argv[1]) > 0)
+        slots = (usize)atoi(argv[1]);
+
+    Array<StrView> sources = {};
+    if (!generate_project(sources))
+        return EXIT_FAILURE;
+
+    log_info("Compiling %d files (every %d is heavy) with %zu slots\n", NUMBER_OF_FILES, HEAVY_FILE_EVERY, slots);
+    const char* names[] = {"batch", "window"};
+    for (int mode = 0; mode < 2; ++mode) {
+        u64 busy_time = 0;
+        const auto wall_time = run_jobs(sources, slots, mode == 1, busy_time);
+        const f64 utilization = wall_time > 0 ? (f64)busy_time / ((f64)wall_time * (f64)slots) : 0.0;
+        log_info("%-6s: wall %8.3f s, utilization %5.1f%%\n", names[mode], (f64)wall_time / 1000000.0, utilization * 100.0);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,63 @@
+#define EZBUILD_IMPLEMENTATION
+#include "../../ezbuild.hpp"
+
+using namespace Sl;
+
+int main(int argc, char **argv)
+{
+    rebuild_itself((ExecutableOptions{.debug = true, .std = FlagsSTD::CPP20}),
+                    argc, argv, "../../ezbuild.hpp");
+
+    // Check if this build.cpp script was rebuilt.
+    bool force_rebuilt = was_script_rebuilt(argc, argv);
+
+    // Enable colored logging
+    ScopedLogger _(logger_colored);
+
+    // Every target is configured like a usual build, but end_build() is not called for them
+    Cmd math {};
+    math.start_build(ExecutableOptions{.type = FlagsExecutableType::STATIC_LIB});
+    math.output_file("libmath");
+    math.output_folder(".build_math");
+    math.add_source_file("math/math.cpp");
+
+    Cmd text {};
+    text.start_build(ExecutableOptions{.type = FlagsExecutableType::DYNAMIC_LIB});
+    text.output_file("libtext");
+    text.output_folder(".build_text");
+    text.add_source_file("text/text.cpp");
+
+    Cmd calculator {};
+    calculator.start_build();
+    calculator.output_file("calculator");
+    calculator.output_folder(".build_calculator");
+    calculator.add_source_file("tools/calculator.cpp");
+
+    Cmd squares {};
+    squares.start_build();
+    squares.output_file("squares");
+    squares.output_folder(".build_squares");
+    squares.add_source_file("tools/squares.cpp");
+
+    if (get_system() != FlagsSystem::WINDOWS) {
+        // Executables look for libtext.so next to them
+        calculator.add_linker_flag("-rpath,$ORIGIN");
+        squares.add_linker_flag("-rpath,$ORIGIN");
+    }
+
+    // Compile jobs of all targets run in one process pool,
+    //  executables are linked as soon as libraries they depend on are ready.
+    BuildGraph graph {};
+    const auto math_id = graph.add_target(math);
+    const auto text_id = graph.add_target(text);
+    const auto calculator_id = graph.add_target(calculator);
+    const auto squares_id = graph.add_target(squares);
+    // Output of dependency library is linked into target
+    graph.add_dependency(calculator_id, math_id);
+    graph.add_dependency(calculator_id, text_id);
+    graph.add_dependency(squares_id, math_id);
+    graph.add_dependency(squares_id, text_id);
+
+    if (!graph.build(0, force_rebuilt))
+        return EXIT_FAILURE;
+}
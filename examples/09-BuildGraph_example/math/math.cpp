@@ -0,0 +1,11 @@
+#include "math.h"
+
+int add(int a, int b)
+{
+    return a + b;
+}
+
+int multiply(int a, int b)
+{
+    return a * b;
+}
@@ -0,0 +1,7 @@
+#include "text.h"
+#include <stdio.h>
+
+void print_number(const char* name, int value)
+{
+    printf("%s = %d\n", name, value);
+}
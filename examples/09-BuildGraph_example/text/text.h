@@ -0,0 +1,3 @@
+#pragma once
+
+void print_number(const char* name, int value);
@@ -0,0 +1,8 @@
+#include "../math/math.h"
+#include "../text/text.h"
+
+int main()
+{
+    print_number("2 + 3", add(2, 3));
+    print_number("2 * 3", multiply(2, 3));
+}
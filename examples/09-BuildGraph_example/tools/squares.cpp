@@ -0,0 +1,8 @@
+#include "../math/math.h"
+#include "../text/text.h"
+
+int main()
+{
+    for (int i = 1; i <= 3; ++i)
+        print_number("square", multiply(i, i));
+}
@@ -9,9 +9,25 @@
 // This will disable automatically setting console to UTF-8 on Windows (Does nothing on other OS..)
 //  #define EZBUILD_DONT_SET_CONSOLE
 //
+// This will make rebuild_itself() compile implementation of this library together with build script every time,
+//  instead of linking it from object in user cache folder (compiled once for compiler, flags and configuration macros)
+//  #define EZBUILD_NO_CACHED_IMPLEMENTATION
+//
+// This will disable GNU make jobserver (taking process tokens from parent make and serving them to child processes)
+//  #define EZBUILD_NO_JOBSERVER
+//
+// This will make build script create its own jobserver, when it isn't started by make,
+//  so compile and link processes (-flto=jobserver, sub-makes) share processes of the build
+//  #define EZBUILD_CREATE_JOBSERVER
+//
 // This will controll max size of error message buffer (If you don't understand, best to leave it default)
 //  #define EZBUILD_ERROR_MESSAGE_SIZE (size)
 
+// Implementation is already compiled into cached object, that is linked with build script (see rebuild_itself())
+#if defined(EZBUILD_IMPLEMENTATION) && defined(EZBUILD_IMPLEMENTATION_IS_LINKED)
+#   undef EZBUILD_IMPLEMENTATION
+#endif // EZBUILD_IMPLEMENTATION_IS_LINKED
+
 #if defined(EZBUILD_IMPLEMENTATION)
 #   define SL_IMPLEMENTATION
 #   include "Sl.hpp"
@@ -26,6 +42,7 @@
 #ifdef _WIN32
 #   define WIN32_LEAN_AND_MEAN
 #   include <windows.h>
+#   include <psapi.h>
 #else
 #   include <fcntl.h>
 #   include <errno.h>
@@ -35,6 +52,20 @@
 #   include <sys/types.h>
 #   include <sys/stat.h>
 #   include <sys/wait.h>
+#   include <sys/resource.h>
+#   include <sys/mman.h>
+#   include <time.h>
+#   include <poll.h>
+#   include <signal.h>
+#   include <netdb.h>
+#   include <sys/socket.h>
+#   include <sys/un.h>
+#   if defined(__linux__)
+#       include <sys/ioctl.h>
+#       include <sys/syscall.h>
+#       include <sys/inotify.h>
+#       include <linux/fs.h>
+#   endif // __linux__
 #endif // _WIN32
 
 #ifndef EZBUILD_ERROR_MESSAGE_SIZE
@@ -56,18 +87,30 @@ namespace Sl
         typedef int ThreadId;
         typedef int ProcessDescriptor;
         typedef int FileHandle;
-        typedef time_t FileTimeUnit;
+        // Seconds and nanoseconds, so edits made in the same second as last build are still noticed
+        struct FileTimeUnit
+        {
+            s64 seconds;
+            s64 nanoseconds;
+        };
         #define INVALID_PROCESS -1
         #define INVALID_FILE_HANDLE static_cast<FileHandle>(-1)
     #endif // _WIN32
 
     struct Process;
     struct Processes;
+    struct JobServer;
     struct SystemInfo;
     struct ExecutableOptions;
     struct CmdOptions;
     struct FileTime;
     struct FileEntry;
+    struct FileMapping;
+    struct FileStatCache;
+    struct BuildDatabase;
+    struct BuildState;
+    struct BuildTrace;
+    struct BuildGraph;
 
     enum class FlagsFile
     {
@@ -168,9 +211,11 @@ namespace Sl
     // If build script was rebuilt last time - returns true
     bool was_script_rebuilt(int argc, char** argv);
     // Compares time of depency files with provided file. If true, that means file needs to be rebuilt. Useful for non C/C++ builds.
-    Result file_needs_rebuilt(StrView file, LocalArray<StrView>& dependency_files);
+    // If stat cache is provided, every file is checked only once (with one stat call)
+    Result file_needs_rebuilt(StrView file, LocalArray<StrView>& dependency_files, FileStatCache* stat_cache = nullptr);
     // Must-have for incremental builds. This function checks depencies of C/C++ file by itself (for example #include "...").
-    Result file_needs_rebuilt_cpp(StrView obj, StrView src_file, StrView output_folder = "", StrView custom_compiler = "", HashMap<StrView, FileTimeUnit, StrView::hash>* memoization = nullptr);
+    // If database is provided, dependencies are taken from it instead of parsing dependency file (when object wasn't changed since)
+    Result file_needs_rebuilt_cpp(StrView obj, StrView src_file, StrView output_folder = "", StrView custom_compiler = "", FileStatCache* stat_cache = nullptr, BuildDatabase* database = nullptr);
     // Checks if provided argument is supported for current compiler
     bool is_flag_supported_cpp(StrView expected_flag);
     // Returns all supported flags for current compiler
@@ -185,6 +230,10 @@ namespace Sl
     bool write_to_file(StrView file, const char* data, usize size);
     bool write_to_file(FileHandle file_handle, const char* data, usize size);
     bool rename_file(StrView from, StrView to);
+    // Overwrites destination file. On Linux it tries to make a reflink (copy on write clone) first
+    bool copy_file(StrView from, StrView to);
+    // Resolves path relative to current working directory (only ASCII paths are supported)
+    bool get_absolute_path(StrView path, StrBuilder& path_out);
     bool close_file(FileHandle file_handle);
     bool get_file_time(FileHandle file_handle, FileTime& file_time_out);
     bool get_file_size(FileHandle file_handle, usize& file_size_out);
@@ -192,10 +241,23 @@ namespace Sl
     bool read_folder(StrView folder_path, Array<FileEntry>& files_out);
     bool read_entire_file(StrView file_path, StrBuilder& buffer);
     bool read_entire_file(FileHandle file_handle, StrBuilder& buffer);
+    // Maps whole file into memory (read only)
+    bool map_file(StrView file, FileMapping& mapping_out);
+    bool unmap_file(FileMapping& mapping);
     bool read_dependencies(StrView depency_path, Array<StrView>& depencies_out, StrView output_folder = "", StrView custom_compiler = "");
+    // Aggregates Clang time trace files (-ftime-trace) and prints slowest translation units, includes with the biggest
+    //  total parse time (inclusive time of all inclusions) and costliest template instantiations
+    bool report_time_trace(Array<StrView>& trace_files, usize top_count = 10);
+    // Runs compile worker, which compiles preprocessed files for build scripts on other machines (see Cmd::add_remote_worker()).
+    //  Address is "unix:path" or "host:port" (empty host means loopback), up to max_jobs files are compiled at once
+    //  (0 = number of processors). Clients have to send the secret, worker runs only known compilers with allowed options.
+    //  Traffic isn't encrypted, so listen on other than loopback only on trusted networks. Returns only if it failed (POSIX only)
+    bool run_compile_worker(StrView address, StrView secret, usize max_jobs = 0);
     // Check if argument is set
     bool is_argument_set(StrView expected_arg, int argc, char** argv);
     SystemInfo get_system_info();
+    // Returns monotonic time in microseconds, useful for measuring durations
+    u64 get_monotonic_time();
     usize get_last_error_code();
     const char* get_error_message();
     FlagsCompiler get_compiler();
@@ -207,7 +269,24 @@ namespace Sl
     struct ExecutableOptions
     {
         bool is_cpp = true; // compile with C++ or C compiler
+        // Static library is always built incrementally (from objects in output folder)
+        FlagsExecutableType type = FlagsExecutableType::EXECUTABLE;
+        // Static library only references objects in output folder instead of copying them (GNU ar only)
+        bool thin_archive = false;
         bool incremental_build = true;
+        // Compiler writes dependency file by itself while compiling (-MMD -MF or /sourceDependencies),
+        //  instead of running separate preprocessor pass for every changed file
+        bool single_pass_dependencies = false;
+        // Files are compared by content hash, so changed write time without changed content
+        //  (after git checkout, touch...) doesn't cause recompilation
+        bool content_hash = false;
+        // Sources are grouped into generated translation units (balanced by size) when every one of them has to be compiled,
+        //  after that, files of changed groups are compiled separately again
+        bool unity_build = false;
+        u32 unity_batches = 0; // 0 = number of processors
+        // Clang only, every compiled file writes time trace next to its object (-ftime-trace),
+        //  after the build they are aggregated by report_time_trace()
+        bool time_trace = false;
         bool debug = false;
         FlagsOptimization optimize = FlagsOptimization::NONE;
         FlagsWarning warnings = FlagsWarning::NONE;
@@ -222,6 +301,7 @@ namespace Sl
         ProcessDescriptor* stdin_desc = nullptr;
         ProcessDescriptor* stdout_desc = nullptr;
         ProcessDescriptor* stderr_desc = nullptr;
+        JobServer* job_server = nullptr; // Own jobserver is visible only to processes, that are started with it
     };
     // Main object of this library, it has two uses:
     //  1) You can use it, to run system processes
@@ -243,6 +323,11 @@ namespace Sl
             custom_flags.cleanup();
             custom_arguments.cleanup();
             defines.cleanup();
+            unity_excluded_files.cleanup();
+            remote_workers.cleanup();
+            remote_worker_secrets.cleanup();
+            forget_created_folders();
+            created_folders.cleanup();
         }
 
         // This will push escaped strings to internal buffer, ultimately creating a "command"
@@ -265,17 +350,43 @@ namespace Sl
         void reset();
         // Full reset for reuse, preserves allocated memory
         void clear();
+        // Returns hash of current command, can be used to detect if flags of the command were changed
+        u64 get_command_fingerprint() const;
     // This functions are responsible for С/C++ build
     //-------------------------------------------------------------------
         // Starts the build, appending some commands to internal buffer
         void start_build(ExecutableOptions opt = {}, StrView custom_compiler = "");
         // End the build, flushing all the commands
         bool end_build(bool run, bool force_rebuilt = false);
+        // Builds like end_build(), and then keeps build database in memory and waits for changes of sources
+        //  and their dependencies (inotify), recompiling only affected objects and linking again.
+        //  It returns only if watching failed (Linux only).
+        bool watch_build(bool run = false);
+        // Sources, that would be compiled again if provided file (source or header) was changed, by build database
+        //  of the last build in output folder. It can be used to know size of rebuild before building.
+        //  Returns false if there is no build database yet
+        bool find_affected_sources(StrView file, Array<StrView>& sources_out);
     // Funtions down below can be called in between start_build() and end_build() in order to configure build steps
         // Set output file name to provided one
         void output_file(StrView file, bool contains_ext = false);
         // Sets the folder, where all temporary files will be generated (optional, by default ".build")
         void output_folder(StrView folder);
+        // Enables local object cache in provided folder, it can be shared between output folders and projects.
+        //  Before compiling, object is looked up by command, compiler and content of source and its dependencies.
+        void object_cache_folder(StrView folder);
+        // Every process of the build (dependency scan, compile, link, run) is written to provided file
+        //  in Chrome tracing format, it can be opened in chrome://tracing or ui.perfetto.dev
+        void trace_file(StrView file);
+        // Compile jobs are shared with worker (run_compile_worker()) on provided address ("unix:path" or "host:port").
+        //  Every job goes to the least loaded of local processes and workers, files are preprocessed locally and workers
+        //  send back objects. Secret has to match the one of the worker. Unreachable worker and files with options, that
+        //  worker doesn't allow, are compiled locally (GCC and Clang without precompiled header, POSIX only)
+        void add_remote_worker(StrView address, StrView secret);
+        // Header is precompiled once (to .gch/.pch in output folder) before other files, and then forcibly included in every of them.
+        //  It is rebuilt like any object: when it, its dependencies or build flags are changed.
+        void add_precompiled_header(StrView header);
+        // Source file will always be compiled separately in unity build
+        void exclude_from_unity_build(StrView file);
         // Add source file to build step
         void add_source_file(StrView file);
         // Add source files to build step from a array
@@ -321,7 +432,39 @@ namespace Sl
         void append_custom_flags();
         void append_linker_flags(FlagsCompiler compiler);
         void append_output_name(FlagsCompiler compiler, bool append_flag = true);
+        // Pushes archiver (ar or lib) command that writes static library to provided path
+        void append_archive_command(FlagsCompiler compiler, StrView output_path);
+        // Incremental build is made of steps, end_build() (and BuildGraph) runs them one after another:
+        //  prepare_build() decides what has to be compiled and prepares compile commands (historically slowest first),
+        //  execute_compile_job() starts one of them asynchronously, finish_compile_job() records it after it exited,
+        //  finish_compiles() records compiled objects and puts link command into internal buffer (if link is needed),
+        //  finish_link() records linked output and saves build database.
+        bool prepare_build(BuildState& state, bool force_rebuilt);
+        Process execute_compile_job(BuildState& state, usize job, Processes& procs);
+        void finish_compile_job(BuildState& state, const Process& finished);
+        // Expected peak memory of compile job, it's taken from previous build
+        u64 predict_job_memory(BuildState& state, usize job);
+        // Returns true if compile job can be started now without exceeding memory budget
+        bool fits_memory_budget(BuildState& state, usize job, usize running_processes);
+        // Returns part of compile command for the file, which goes after compiler flags (first "mark" bytes of buffer)
+        StrView get_compile_command(FlagsCompiler compiler, StrView file, usize mark);
+        bool finish_compiles(BuildState& state, bool& needs_link_out);
+        void finish_link(BuildState& state, bool linked);
+        // Runs built executable with run arguments
+        void run_output(FlagsCompiler compiler, BuildTrace* trace = nullptr);
+        // Creates folders of the file inside output folder (like mkdir -p), folders that were already created
+        //  or found during this build are skipped without any file system call
         void build_tree_of_folders(StrView file);
+        // Forgets created folders and closes output folder, called when build ends or output folder changes
+        void forget_created_folders();
+        // Builds precompiled header if needed
+        bool build_precompiled_header(FlagsCompiler compiler, bool& rebuilt_out, BuildDatabase* database = nullptr, FileStatCache* stat_cache = nullptr,
+                                      BuildTrace* trace = nullptr);
+        // Appends flags, that use precompiled header, to internal buffer (only compile commands need them, not link)
+        void append_precompiled_header_flags(FlagsCompiler compiler);
+        // Splits stale sources between unity batches and separate objects, writing generated translation units
+        bool plan_unity_build(BuildDatabase& database, FileStatCache* stat_cache, u64 command_hash,
+                              Array<bool>& stale_sources, Array<StrView>& compile_files_out, Array<StrView>& link_objects_out);
         // Returns compiler based on custom_compiler if set, otherwise detects system compiler
         FlagsCompiler get_effective_compiler();
         // Check if build is started, if not exits the program
@@ -336,13 +479,37 @@ namespace Sl
         Array<StrView> custom_flags = {};
         Array<StrView> custom_arguments = {};
         Array<StrView> defines = {};
+        Array<StrView> unity_excluded_files = {};
+        Array<StrView> remote_workers = {};
+        Array<StrView> remote_worker_secrets = {};
+        HashMap<StrView, bool, StrView::hash> created_folders = {}; // Relative to output folder
+    #if !defined(_WIN32)
+        int            _output_folder_fd = -1; // Folders are created relative to it (mkdirat)
+    #endif // !_WIN32
         StrView        output_name = {"a", 1, true, false};
         StrView        _output_folder = {".build", 6, true, false};
         bool           _build_started = false;
         bool           output_contains_ext = false;
+        bool           is_cpp = true;
+        FlagsExecutableType executable_type = FlagsExecutableType::EXECUTABLE;
+        bool           thin_archive = false;
         bool           incremental_build = true;
+        bool           single_pass_dependencies = false;
+        bool           content_hash = false;
+        bool           unity_build = false;
+        u32            unity_batches = 0;
+        bool           time_trace = false;
         u32            max_concurrent_processes = 0;
+        // Compiles are held back, when their expected memory (peak memory from previous build) would exceed it.
+        //  0 = memory available at the start of the build
+        u64            memory_budget = 0;
         StrView        _custom_compiler = "";
+        StrView        _object_cache_folder = "";
+        StrView        _precompiled_header = "";
+        StrView        _trace_file = "";
+        // Object cache statistics, they are not reset by clear()
+        u32            cache_hits = 0;
+        u32            cache_misses = 0;
     };
 
     struct FileTime
@@ -370,12 +537,15 @@ namespace Sl
         ProcessID threadId;
         bool done;
         bool error_happened;
+        s32 exit_code;   // Known after wait(), -1 if process couldn't be waited on
+        u64 peak_memory; // Peak resident memory in bytes, known after wait(), 0 if unknown
+        bool is_remote;  // Waits on remote worker, so it doesn't hold jobserver token
 
         Process()
-            : id(INVALID_PROCESS), threadId(INVALID_PROCESS), done(false), error_happened(false)
+            : id(INVALID_PROCESS), threadId(INVALID_PROCESS), done(false), error_happened(false), exit_code(-1), peak_memory(0), is_remote(false)
         {}
         Process(ProcessID id, ThreadId threadId = INVALID_PROCESS)
-            : id(id), threadId(threadId), done(false), error_happened(false)
+            : id(id), threadId(threadId), done(false), error_happened(false), exit_code(-1), peak_memory(0), is_remote(false)
         {}
 
         bool wait();
@@ -387,6 +557,312 @@ namespace Sl
             wait_all();
         }
         bool wait_all(bool clear_array = true);
+        // Waits until any process exits and removes it from the array.
+        // Returns false if that process failed (or there was nothing to wait on)
+        bool wait_any(Process* finished_out = nullptr);
+        // Call before starting next process. If there's job server, every local process beyond the first one
+        //  needs its token, false means that there's no free token right now (wait for some process then)
+        bool reserve_slot();
+        // Gives back tokens, that local processes don't need anymore (some exited or turned out to be remote)
+        void release_unused_slots();
+        usize local_count() const;
+    public:
+        JobServer* job_server = nullptr;
+    };
+
+    // GNU make jobserver (pipe, fifo or Windows semaphore from MAKEFLAGS --jobserver-auth).
+    //  Every process beyond the first one holds a token, which is returned to jobserver when process exits.
+    struct JobServer
+    {
+        ~JobServer() {
+            cleanup();
+        }
+        // Connects to jobserver of parent make, if MAKEFLAGS has one
+        bool connect();
+        // Creates jobserver for provided number of processes, so child processes (make, -flto=jobserver,
+        //  other build scripts) share these processes. It isn't inherited by anyone until expose() is called
+        bool create(usize max_processes);
+        // Makes own jobserver visible (descriptors and MAKEFLAGS) to process, that is started next.
+        //  On POSIX it's called in forked child, on Windows hide() reverts it after process is created
+        void expose();
+        void hide();
+        // Takes token without blocking
+        bool try_acquire();
+        void release();
+        usize held() const { return tokens.count(); }
+        void cleanup();
+    public:
+        Array<char> tokens = {}; // Tokens are written back as they were read
+        StrView makeflags = "";  // MAKEFLAGS of child processes, when jobserver is own one
+    #ifdef _WIN32
+        HANDLE semaphore = NULL;
+        StrView saved_makeflags = "";
+        bool has_saved_makeflags = false;
+    #else
+        int read_fd = -1;
+        int write_fd = -1;
+        int shared_read_fd = -1; // Blocking end of own pipe, which children inherit
+        bool is_read_nonblocking = false;
+        bool is_fifo = false;
+    #endif // _WIN32
+        bool is_owner = false;
+    };
+    // Job server of this process: connects to parent make or creates own one (EZBUILD_CREATE_JOBSERVER) on first call.
+    //  Returns nullptr if it's disabled (EZBUILD_NO_JOBSERVER) or unavailable
+    JobServer* get_job_server(usize max_processes);
+
+    struct FileMapping
+    {
+        const char* data = nullptr;
+        usize size = 0;
+        FileHandle file = INVALID_FILE_HANDLE;
+    #ifdef _WIN32
+        HANDLE mapping = NULL;
+    #endif // _WIN32
+    };
+
+    struct FileStat
+    {
+        FileTimeUnit time; // Last write time
+        u64 size;
+        bool exists;
+    };
+
+    // File metadata of one build: every unique path is queried only once (by path, without opening the file),
+    //  all later existence, size and write time checks of the path are answered from memory.
+    //  Files, which are written during the build, have to be invalidated.
+    struct FileStatCache
+    {
+        ~FileStatCache() {
+            cleanup();
+        }
+        FileStat get(StrView path);
+        bool exists(StrView path);
+        bool get_time(StrView path, FileTimeUnit& time_out);
+        bool get_size(StrView path, u64& size_out);
+        void invalidate(StrView path);
+        // Forgets all paths, counter is kept
+        void clear();
+        void cleanup();
+    public:
+        HashMap<StrView, FileStat, StrView::hash> stats = {};
+        ArenaAllocator keys;  // Copies of paths, they are freed all at once by clear()
+        u32 stat_calls = 0; // Number of queries made to file system
+    };
+
+    struct BuildPathInfo
+    {
+        FileTimeUnit time; // Last seen write time
+        u64 size;
+        u64 digest;        // Hash of the content, 0 if unknown (used only in content hash mode)
+        u64 compile_time;  // Wall time of last compilation of the source in microseconds, 0 if unknown
+        u64 compile_memory; // Peak memory of compiler, when it compiled the source last time, 0 if unknown
+    };
+
+    struct BuildRecord
+    {
+        u32 object_id;
+        u32 source_id;
+        u32 first_dependency; // Index into BuildDatabase::dependencies
+        u32 dependency_count;
+        u64 command_hash;
+        FileTimeUnit object_time; // Time of object file, when this record was made
+    };
+
+    // Linked output (executable or library). It's kept apart from records of objects,
+    //  so outputs and objects aren't part of the reverse index of sources and their dependencies
+    struct BuildLinkRecord
+    {
+        u32 output_id;
+        u32 reserved;
+        u64 command_hash; // Hash of link command, which lists all objects
+    };
+
+    // Path in dependency graph of current build, every header is one node no matter how many files include it,
+    //  so its write time is queried once. Objects compare it with their own write time (see file_needs_rebuilt_cpp())
+    struct BuildNode
+    {
+        enum State : u8
+        {
+            NOT_CHECKED = 0,
+            MISSING,
+            FOUND,
+        };
+        FileTimeUnit time;
+        State state;
+    };
+
+    // Binary build log, which is stored in output folder.
+    // It remembers dependencies of every object file (as interned path ids),
+    //  so no-op builds don't need to read and parse dependency files, and link command of every output.
+    struct BuildDatabase
+    {
+        static const u32 INVALID_ID = (u32)-1;
+        static const u32 MAGIC = 0x42445a45; // "EZDB"
+        static const u32 VERSION = 6;
+
+        ~BuildDatabase() {
+            cleanup();
+        }
+        // Maps database from output folder. If there's no valid database, it will start empty
+        bool load(StrView output_folder);
+        // Writes database to temporary file and then replaces old one with it.
+        //  Database is cleaned up after that, since loaded paths point into mapped file
+        bool save();
+        void cleanup();
+        u32 intern_path(StrView path);
+        u32 find_path(StrView path);
+        BuildRecord* find_record(StrView object);
+        void update_record(StrView object, StrView source, Array<StrView>& dependencies_list, FileTimeUnit object_time, u64 command_hash);
+        BuildLinkRecord* find_link(StrView output);
+        void update_link(StrView output, u64 command_hash);
+        // Checks if content of the path differs from content seen by previous build (checked once per build).
+        //  SL_ERROR means that there's nothing to compare with, so caller should fallback to write time.
+        //  Hashing is skipped when size and write time are the same as before.
+        Result check_content(u32 path_id);
+        // Node of the path in dependency graph, its write time is queried once per build.
+        //  Content hash of the path, which was changed since it was hashed, is forgotten.
+        BuildNode get_node(u32 path_id);
+        // Reverse index: records of objects, which have provided path as source or dependency
+        void find_dependents(u32 path_id, Array<u32>& records_out);
+        // Sources of objects, that depend on any of provided paths (each source is listed once).
+        //  It can be used to know which files would be rebuilt, before building them
+        void find_affected_sources(const Array<u32>& path_ids, Array<StrView>& sources_out);
+    public:
+        Array<StrView> paths = {};
+        Array<BuildPathInfo> path_infos = {};
+        Array<s8> path_states = {}; // Result of check_content() for current build, per path
+        Array<BuildNode> nodes = {};  // Per path, see get_node()
+        // Reverse index is made from records on first use, record indices of path "i" are
+        //  dependents[dependents_offsets[i]..dependents_offsets[i + 1]]
+        Array<u32> dependents_offsets = {};
+        Array<u32> dependents = {};
+        Array<u32> dependencies = {};
+        Array<BuildRecord> records = {};
+        Array<BuildLinkRecord> links = {};
+        HashMap<StrView, u32, StrView::hash> path_ids = {};
+        HashMap<u32, u32> record_ids = {}; // object path id -> index of record
+        HashMap<u32, u32> link_ids = {};   // output path id -> index of link record
+        FileMapping mapping = {};
+        StrView database_path = "";
+        FileStatCache* stat_cache = nullptr; // If set, sizes and write times are taken from it
+        bool is_changed = false;
+        bool use_content_hash = false;
+        bool is_reverse_index_valid = false;
+    };
+
+    // Timeline of build processes. Every process takes the first free slot (lane), so the trace shows
+    //  how well process pool is utilized
+    struct BuildTrace
+    {
+        struct Event
+        {
+            StrView category = ""; // "scan", "compile", "link" or "run"
+            StrView name = "";
+            StrView command = "";
+            ProcessID id = INVALID_PROCESS;
+            u64 start = 0; // Microseconds since start of the trace
+            u64 end = 0;
+            u32 lane = 0;
+            s32 exit_code = -1;
+            bool finished = false;
+        };
+        BuildTrace() : start_time(get_monotonic_time()) {}
+        ~BuildTrace() {
+            cleanup();
+        }
+        // Call right after process was started, command is copied
+        void begin(StrView category, StrView name, StrView command, ProcessID id);
+        void end(const Process& process);
+        // Writes events in Chrome tracing (JSON) format
+        bool write(StrView file);
+        void cleanup();
+    public:
+        Array<Event> events = {};
+        Array<bool> busy_lanes = {};
+        u64 start_time;
+    };
+
+    // State of incremental build between its steps (see Cmd::prepare_build)
+    struct RemoteWorker
+    {
+        StrView address = "";
+        StrView secret = "";
+        u32 slots = 0;
+        u32 running = 0; // Including compiles of other clients, that ran when the build started
+    };
+
+    struct BuildState
+    {
+        ~BuildState() {
+            compile_files.cleanup();
+            compile_commands.cleanup();
+            manifest_keys.cleanup();
+            restored_from_cache.cleanup();
+            link_objects.cleanup();
+            job_processes.cleanup();
+            job_start_times.cleanup();
+            job_durations.cleanup();
+            job_memory.cleanup();
+            job_peak_memory.cleanup();
+            job_workers.cleanup();
+            remote_workers.cleanup();
+        }
+        BuildDatabase database;
+        FileStatCache stat_cache;
+        Array<StrView> compile_files = {};
+        Array<StrView> compile_commands = {}; // Command without compiler flags, empty if object was restored from cache
+        Array<u64> manifest_keys = {};        // Object cache key, 0 = object can't be cached
+        Array<bool> restored_from_cache = {};
+        Array<StrView> link_objects = {};
+        Array<ProcessID> job_processes = {};   // Per compile job, they are filled when job is started
+        Array<u64> job_start_times = {};
+        Array<u64> job_durations = {};         // Microseconds, 0 if job wasn't finished
+        Array<u64> job_memory = {};            // Memory, which was reserved for running job
+        Array<u64> job_peak_memory = {};       // Measured peak memory of finished job
+        Array<s32> job_workers = {};           // Index of remote worker, which compiles the job, -1 = local process
+        Array<RemoteWorker> remote_workers = {}; // Workers, that responded at the start of the build
+        u32 remote_slots = 0;                  // Compiles, that workers run at once, they are on top of local processes
+        u32 local_slots = 0;
+        u32 local_running = 0;
+        u64 memory_budget = 0;                 // New compile isn't started, if running ones would exceed it
+        u64 running_memory = 0;
+        u64 average_compile_memory = 0;        // Expected peak memory of files, that weren't compiled before
+        BuildTrace* trace = nullptr;          // Processes are recorded if it's set
+        StrView output_path = "";
+        usize mark = 0;                       // Size of compiler flags in command buffer
+        u64 command_hash = 0;
+        u64 link_hash = 0;
+        u32 saved_cache_hits = 0;
+        u32 saved_cache_misses = 0;
+        bool needs_to_rebuilt = false;
+    };
+
+    // Builds several targets at once: compile jobs of all targets share one process pool,
+    //  and every target is linked as soon as its objects and targets it depends on are ready.
+    struct BuildGraph
+    {
+        struct Dependency
+        {
+            usize target;
+            usize dependency;
+        };
+        ~BuildGraph() {
+            targets.cleanup();
+            dependencies.cleanup();
+        }
+        // Target has to be configured already (start_build() was called), it has to be built incrementally
+        //  and has to have its own output folder. Returns id of the target
+        usize add_target(Cmd& target);
+        // Target is linked after dependency, and output of dependency (if it's a library) is linked into target
+        void add_dependency(usize target, usize dependency);
+        // Builds all targets, end_build() is not needed for them. 0 = default number of processes.
+        //  Remote workers of targets take compiles on top of local processes, build trace (if any target has trace file)
+        //  records processes of all targets
+        bool build(u32 max_concurrent_processes = 0, bool force_rebuilt = false);
+    public:
+        Array<Cmd*> targets = {};
+        Array<Dependency> dependencies = {};
     };
 
     struct SystemInfo
@@ -422,10 +898,40 @@ namespace Sl
         info.page_size            = sysconf(_SC_PAGESIZE);
         info.total_memory         = phys_pages > 0 ? (usize)phys_pages * info.page_size : 0;
         info.available_memory     = avphys_pages > 0 ? (usize)avphys_pages * info.page_size : 0;
+    #if defined(__linux__)
+        // Free pages don't include page cache, which kernel can give back when it's needed
+        const int meminfo = open("/proc/meminfo", O_RDONLY | O_CLOEXEC);
+        if (meminfo >= 0) {
+            char buffer[4096];
+            const ssize_t length = read(meminfo, buffer, sizeof(buffer) - 1);
+            close(meminfo);
+            if (length > 0) {
+                buffer[length] = '\0';
+                const char* available = strstr(buffer, "MemAvailable:");
+                if (available) info.available_memory = (usize)strtoull(available + 13, nullptr, 10) * 1024;
+            }
+        }
+    #endif // __linux__
     #endif // !_WIN32
         return info;
     }
 
+    u64 get_monotonic_time()
+    {
+    #ifdef _WIN32
+        static LARGE_INTEGER frequency = {};
+        if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        return (u64)(counter.QuadPart / frequency.QuadPart) * 1000000ull
+             + (u64)(counter.QuadPart % frequency.QuadPart) * 1000000ull / (u64)frequency.QuadPart;
+    #else
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (u64)ts.tv_sec * 1000000ull + (u64)ts.tv_nsec / 1000ull;
+    #endif // !_WIN32
+    }
+
     inline static void report_error(const char* const format, ...) SL_PRINTF_FORMATER(1, 2);
     inline static void report_error(const char* const format, ...)
     {
@@ -560,6 +1066,98 @@ namespace Sl
         if (!result) report_error("Could not rename file \"%s\" to \"%s\"", error_string(file_from_path, from_is_wide), error_string(file_to_path, to_is_wide));
         return result;
     }
+    bool copy_file(StrView from, StrView to)
+    {
+        if (from.size == 0 || to.size == 0) return false;
+    #if defined(_WIN32)
+        StrBuilder buffer_from(get_global_allocator());
+        bool from_is_wide = from.is_wide;
+        StrBuilder buffer_to(get_global_allocator());
+        bool to_is_wide = to.is_wide;
+
+        bool force_wide = from.contains_non_ascii_char() || to.contains_non_ascii_char();
+        const char* file_from_path = normalize_path(buffer_from, from, from_is_wide, force_wide);
+        const char* file_to_path = normalize_path(buffer_to, to, to_is_wide, force_wide);
+        bool result;
+        if (from_is_wide || to_is_wide)
+            result = CopyFileW((LPCWSTR)file_from_path, (LPCWSTR)file_to_path, FALSE);
+        else
+            result = CopyFileA(file_from_path, file_to_path, FALSE);
+        if (!result) report_error("Could not copy file \"%s\" to \"%s\"", error_string(file_from_path, from_is_wide), error_string(file_to_path, to_is_wide));
+        return result;
+    #else
+        FileHandle from_handle;
+        if (!open_file(from, from_handle)) return false;
+        FileHandle to_handle;
+        if (!create_file(to, to_handle)) {
+            close_file(from_handle);
+            return false;
+        }
+        bool result = false;
+        #if defined(__linux__) && defined(FICLONE)
+            result = ioctl(to_handle, FICLONE, from_handle) == 0;
+        #endif // __linux__ && FICLONE
+        if (!result) {
+            char buffer[1024 * 64];
+            result = true;
+            while (true) {
+                ssize_t bytes_read = read(from_handle, buffer, sizeof(buffer));
+                if (bytes_read < 0) {
+                    report_error("Could not read file \"" SV_FORMAT "\"", SV_ARG(from));
+                    result = false;
+                    break;
+                }
+                if (bytes_read == 0) break;
+                if (!write_to_file(to_handle, buffer, (usize)bytes_read)) {
+                    result = false;
+                    break;
+                }
+            }
+        }
+        close_file(from_handle);
+        close_file(to_handle);
+        return result;
+    #endif // !_WIN32
+    }
+    bool get_absolute_path(StrView path, StrBuilder& path_out)
+    {
+        StrBuilder buffer(get_global_allocator());
+        buffer.append(path);
+        buffer.append_null(false);
+    #if defined(_WIN32)
+        char full_path[MAX_PATH];
+        const DWORD length = GetFullPathNameA(buffer.data(), MAX_PATH, full_path, nullptr);
+        if (length == 0 || length >= MAX_PATH) {
+            report_error("Could not get absolute path of \"" SV_FORMAT "\"", SV_ARG(path));
+            return false;
+        }
+        for (DWORD i = 0; i < length; ++i)
+            if (full_path[i] == '\\') full_path[i] = '/';
+        path_out.append(full_path, length);
+    #else
+        char* full_path = realpath(buffer.data(), nullptr);
+        if (full_path == nullptr) {
+            report_error("Could not get absolute path of \"" SV_FORMAT "\"", SV_ARG(path));
+            return false;
+        }
+        path_out.append(full_path, strlen(full_path));
+        free(full_path);
+    #endif // !_WIN32
+        path_out.append_null(false);
+        return true;
+    }
+#if !defined(_WIN32)
+    // Nanosecond part of stat times has different names on Apple systems
+#   if defined(__APPLE__)
+#       define EZBUILD_STAT_TIME(st, kind) (st).st_##kind##timespec
+#   else
+#       define EZBUILD_STAT_TIME(st, kind) (st).st_##kind##tim
+#   endif // __APPLE__
+    static FileTimeUnit to_file_time(const struct timespec& time)
+    {
+        return FileTimeUnit{(s64)time.tv_sec, (s64)time.tv_nsec};
+    }
+#endif // !_WIN32
     s32 compare_file_time(FileTimeUnit file_time1, FileTimeUnit file_time2)
     {
         // -1 = First is latter
@@ -568,12 +1166,10 @@ namespace Sl
         #if defined(_WIN32)
             return (s32) CompareFileTime(&file_time1, &file_time2);
         #else
-            // Unix times are seconds + nanoseconds (time_t + suseconds_t pattern)
-            // u64 time1_ns = (u64)file_time1.seconds * 1000000000ULL + file_time1.nanoseconds;
-            // u64 time2_ns = (u64)file_time2.seconds * 1000000000ULL + file_time2.nanoseconds;
-
-            if (file_time1 < file_time2) return -1;
-            if (file_time1 > file_time2) return 1;
+            if (file_time1.seconds != file_time2.seconds)
+                return file_time1.seconds < file_time2.seconds ? -1 : 1;
+            if (file_time1.nanoseconds < file_time2.nanoseconds) return -1;
+            if (file_time1.nanoseconds > file_time2.nanoseconds) return 1;
             return 0;
         #endif // !_WIN32
     }
@@ -590,9 +1186,9 @@ namespace Sl
             if (fstat(file_handle, &st) != 0) {
                 result = false;
             } else {
-                file_time_out.creation_time = (FileTimeUnit)st.st_ctime;
-                file_time_out.last_access_time = (FileTimeUnit)st.st_atime;
-                file_time_out.last_write_time = (FileTimeUnit)st.st_mtime;
+                file_time_out.creation_time = to_file_time(EZBUILD_STAT_TIME(st, c));
+                file_time_out.last_access_time = to_file_time(EZBUILD_STAT_TIME(st, a));
+                file_time_out.last_write_time = to_file_time(EZBUILD_STAT_TIME(st, m));
                 result = true;
             }
         #endif // !_WIN32
@@ -1235,10 +1831,72 @@ namespace Sl
         FileHandle file_handle = INVALID_FILE_HANDLE;
         if (!open_file(file_path, file_handle)) return false;
 
-        return read_entire_file(file_handle, buffer);
+        bool result = read_entire_file(file_handle, buffer);
+        close_file(file_handle);
+        return result;
+    }
+    bool map_file(StrView file, FileMapping& mapping_out)
+    {
+        mapping_out = {};
+        if (!open_file(file, mapping_out.file)) return false;
+
+        usize size = 0;
+        if (!get_file_size(mapping_out.file, size)) {
+            unmap_file(mapping_out);
+            return false;
+        }
+        if (size == 0) return true; // Empty file cannot be mapped
+
+    #ifdef _WIN32
+        mapping_out.mapping = CreateFileMappingA(mapping_out.file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping_out.mapping == NULL) {
+            report_error("Could not create file mapping \"" SV_FORMAT "\"", SV_ARG(file));
+            unmap_file(mapping_out);
+            return false;
+        }
+        void* data = MapViewOfFile(mapping_out.mapping, FILE_MAP_READ, 0, 0, 0);
+        if (data == NULL) {
+            report_error("Could not map file \"" SV_FORMAT "\"", SV_ARG(file));
+            unmap_file(mapping_out);
+            return false;
+        }
+    #else
+        void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, mapping_out.file, 0);
+        if (data == MAP_FAILED) {
+            report_error("Could not map file \"" SV_FORMAT "\"", SV_ARG(file));
+            unmap_file(mapping_out);
+            return false;
+        }
+    #endif // !_WIN32
+        mapping_out.data = (const char*)data;
+        mapping_out.size = size;
+        return true;
+    }
+    bool unmap_file(FileMapping& mapping)
+    {
+        bool result = true;
+    #ifdef _WIN32
+        if (mapping.data) result &= UnmapViewOfFile(mapping.data) != 0;
+        if (mapping.mapping != NULL) result &= CloseHandle(mapping.mapping) != 0;
+    #else
+        if (mapping.data) result &= munmap((void*)mapping.data, mapping.size) == 0;
+    #endif // !_WIN32
+        if (mapping.file != INVALID_FILE_HANDLE) result &= close_file(mapping.file);
+        mapping = {};
+        return result;
     }
-    Result file_needs_rebuilt(StrView file, LocalArray<StrView>& dependency_files)
+    Result file_needs_rebuilt(StrView file, LocalArray<StrView>& dependency_files, FileStatCache* stat_cache)
     {
+        if (stat_cache) {
+            FileTimeUnit file_time;
+            if (!stat_cache->get_time(file, file_time)) return Result::SL_ERROR;
+            for (auto& dependency : dependency_files) {
+                FileTimeUnit dependency_time;
+                if (!stat_cache->get_time(dependency, dependency_time)) return Result::SL_ERROR;
+                if (compare_file_time(file_time, dependency_time) < 0) return Result::SL_TRUE;
+            }
+            return Result::SL_FALSE;
+        }
         Result result = Result::SL_FALSE;
         FileHandle h;
         if (!open_file(file, h)) return Result::SL_ERROR;
@@ -1274,10 +1932,349 @@ namespace Sl
         for (auto& proc : *this) {
             success &= proc.wait();
         }
+        if (job_server) {
+            while (job_server->held() > 0)
+                job_server->release();
+        }
         if (clear_array) clear();
         return success;
     }
 
+    bool Processes::wait_any(Process* finished_out)
+    {
+        if (_count < 1) return false;
+
+        usize index = 0;
+        bool found = false;
+    #if defined(_WIN32)
+        // WaitForMultipleObjects takes only MAXIMUM_WAIT_OBJECTS handles, bigger pool is checked in chunks
+        while (!found) {
+            for (usize start = 0; start < _count && !found; start += MAXIMUM_WAIT_OBJECTS) {
+                HANDLE handles[MAXIMUM_WAIT_OBJECTS];
+                const DWORD handles_count = (DWORD)MIN(_count - start, (usize)MAXIMUM_WAIT_OBJECTS);
+                for (DWORD i = 0; i < handles_count; ++i)
+                    handles[i] = _data[start + i].id;
+                // Pool, that fits into one wait, blocks until any process exits, chunks are polled
+                const DWORD timeout = _count <= MAXIMUM_WAIT_OBJECTS ? INFINITE : (start == 0 ? 10 : 0);
+                const DWORD wait_result = WaitForMultipleObjects(handles_count, handles, FALSE, timeout);
+                if (wait_result == WAIT_FAILED) {
+                    report_error("Could not wait on processes");
+                    return false;
+                }
+                if (wait_result >= WAIT_OBJECT_0 && wait_result < WAIT_OBJECT_0 + handles_count) {
+                    index = start + (wait_result - WAIT_OBJECT_0);
+                    found = true;
+                }
+            }
+        }
+    #else
+        // Only members of the pool are waited on, other children of build script are left to their owners.
+        //  WNOWAIT leaves the child in a waitable state, so Process::wait() can still collect its exit status
+        u32 sleep_time = 100;
+        while (!found) {
+            for (usize i = 0; i < _count && !found; ++i) {
+                siginfo_t info;
+                memory_zero(&info, sizeof(info));
+                if (waitid(P_PID, (id_t)_data[i].id, &info, WEXITED | WNOHANG | WNOWAIT) != 0) {
+                    if (errno == EINTR) continue;
+                    // Process::wait() reports process, that can't be waited on
+                    found = true;
+                } else {
+                    found = info.si_pid == _data[i].id;
+                }
+                if (found) index = i;
+            }
+            if (found) break;
+        #if defined(__linux__) && defined(SYS_pidfd_open)
+            // Process descriptor becomes readable when process exits, so wait blocks until any member exits
+            Array<pollfd> descriptors(get_global_allocator());
+            for (usize i = 0; i < _count; ++i) {
+                const int descriptor = (int)syscall(SYS_pidfd_open, _data[i].id, 0);
+                if (descriptor < 0) break;
+                descriptors.push(pollfd{descriptor, POLLIN, 0});
+            }
+            const bool is_polled = descriptors.count() == _count && poll(descriptors.data(), descriptors.count(), -1) >= 0;
+            for (auto& descriptor : descriptors)
+                close(descriptor.fd);
+            descriptors.cleanup();
+            if (is_polled) continue;
+        #endif // __linux__ && SYS_pidfd_open
+            // Without process descriptors members are checked again after short sleep
+            usleep(sleep_time);
+            sleep_time = MIN(sleep_time * 2, (u32)10000);
+        }
+    #endif // !_WIN32
+        bool result = _data[index].wait();
+        if (finished_out) *finished_out = _data[index];
+        remove_unordered(index);
+        release_unused_slots();
+        return result;
+    }
+
+    bool Processes::reserve_slot()
+    {
+        // First process runs on token, which was given to this process by its parent
+        if (!job_server) return true;
+        const auto local = local_count();
+        while (job_server->held() < local) {
+            if (!job_server->try_acquire()) return false;
+        }
+        return true;
+    }
+
+    void Processes::release_unused_slots()
+    {
+        if (!job_server) return;
+        const auto local = local_count();
+        while (job_server->held() > (local > 0 ? local - 1 : 0))
+            job_server->release();
+    }
+
+    usize Processes::local_count() const
+    {
+        usize local = 0;
+        for (usize i = 0; i < _count; ++i)
+            local += _data[i].is_remote ? 0 : 1;
+        return local;
+    }
+
+    bool JobServer::connect()
+    {
+    #if defined(_WIN32)
+        char makeflags_buffer[4096];
+        const DWORD length = GetEnvironmentVariableA("MAKEFLAGS", makeflags_buffer, sizeof(makeflags_buffer));
+        if (length == 0 || length >= sizeof(makeflags_buffer)) return false;
+        StrView makeflags(makeflags_buffer, length);
+    #else
+        const char* makeflags_env = getenv("MAKEFLAGS");
+        if (!makeflags_env) return false;
+        StrView makeflags(makeflags_env, strlen(makeflags_env));
+    #endif // !_WIN32
+        // Last one wins, older make versions use --jobserver-fds
+        StrView auth("");
+        while (makeflags.size > 0) {
+            auto flag = makeflags.chop_left_by_delimeter(" ");
+            flag.trim_right_char(' ');
+            if (flag.starts_with("--jobserver-auth=") || flag.starts_with("--jobserver-fds=")) auth = flag;
+        }
+        if (auth.size == 0) return false;
+        auth.chop_left(auth.find_first('=') + 1);
+
+        StrBuilder value(get_global_allocator());
+        value.append(auth);
+        value.append_null(false);
+    #if defined(_WIN32)
+        semaphore = OpenSemaphoreA(SEMAPHORE_ALL_ACCESS, FALSE, value.data());
+        if (semaphore == NULL) {
+            log_warning("Could not open jobserver semaphore \"%s\", it's not used\n", value.data());
+            return false;
+        }
+    #else
+        if (auth.starts_with("fifo:")) {
+            // Fifo is opened by us, so its reading end can be non blocking without affecting anyone else
+            read_fd = open(value.data() + 5, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+            write_fd = open(value.data() + 5, O_WRONLY | O_CLOEXEC);
+            is_read_nonblocking = true;
+            is_fifo = true;
+        } else {
+            int descriptors[2] = {-1, -1};
+            if (sscanf(value.data(), "%d,%d", &descriptors[0], &descriptors[1]) != 2) return false;
+            // Make closes pipe for commands, that aren't marked as recursive (+ or $(MAKE))
+            if (fcntl(descriptors[0], F_GETFD) < 0 || fcntl(descriptors[1], F_GETFD) < 0) {
+                log_warning("Jobserver of parent make is not available (mark command with '+'), it's not used\n");
+                return false;
+            }
+            write_fd = descriptors[1];
+            read_fd = descriptors[0];
+        #if defined(__linux__)
+            // Own open file description of the pipe can be non blocking, unlike shared one
+            char path[64];
+            snprintf(path, sizeof(path), "/proc/self/fd/%d", descriptors[0]);
+            const int reopened = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+            if (reopened >= 0) {
+                read_fd = reopened;
+                is_read_nonblocking = true;
+            }
+        #endif // __linux__
+        }
+        if (read_fd < 0 || write_fd < 0) {
+            log_warning("Could not open jobserver \"%s\", it's not used\n", value.data());
+            cleanup();
+            return false;
+        }
+    #endif // !_WIN32
+        return true;
+    }
+
+    bool JobServer::create(usize max_processes)
+    {
+        if (max_processes < 2) return false;
+        StrBuilder flags(get_global_allocator());
+    #if defined(_WIN32)
+        StrBuilder name(get_global_allocator());
+        name.appendf("ezbuild_semaphore_%lu", GetCurrentProcessId());
+        name.append_null(false);
+        semaphore = CreateSemaphoreA(NULL, (LONG)(max_processes - 1), (LONG)(max_processes - 1), name.data());
+        if (semaphore == NULL) {
+            report_error("Could not create jobserver semaphore");
+            return false;
+        }
+        flags.appendf(" -j%zu --jobserver-auth=%s", max_processes, name.data());
+    #else
+        int descriptors[2];
+        // Pipe isn't inherited by processes, that aren't started with jobserver (build script's program...)
+    #if defined(__linux__)
+        const bool is_created = pipe2(descriptors, O_CLOEXEC) == 0;
+    #else
+        const bool is_created = pipe(descriptors) == 0;
+        if (is_created) {
+            fcntl(descriptors[0], F_SETFD, FD_CLOEXEC);
+            fcntl(descriptors[1], F_SETFD, FD_CLOEXEC);
+        }
+    #endif // __linux__
+        if (!is_created) {
+            report_error("Could not create jobserver pipe");
+            return false;
+        }
+        read_fd = descriptors[0];
+        write_fd = descriptors[1];
+        shared_read_fd = descriptors[0];
+        is_owner = true;
+        for (usize i = 1; i < max_processes; ++i) {
+            const char token = '+';
+            if (write(write_fd, &token, 1) != 1) {
+                report_error("Could not fill jobserver pipe");
+                cleanup();
+                return false;
+            }
+        }
+        flags.appendf(" -j%zu --jobserver-auth=%d,%d --jobserver-fds=%d,%d", max_processes, read_fd, write_fd, read_fd, write_fd);
+    #if defined(__linux__)
+        // Shared descriptor stays blocking as child processes expect it, own one is non blocking
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/self/fd/%d", read_fd);
+        const int reopened = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (reopened >= 0) {
+            read_fd = reopened;
+            is_read_nonblocking = true;
+        }
+    #endif // __linux__
+    #endif // !_WIN32
+        flags.append_null(false);
+        makeflags = flags.to_string_view(true);
+        is_owner = true;
+        return true;
+    }
+
+    void JobServer::expose()
+    {
+        if (!is_owner) return;
+    #if defined(_WIN32)
+        char makeflags_buffer[4096];
+        const DWORD length = GetEnvironmentVariableA("MAKEFLAGS", makeflags_buffer, sizeof(makeflags_buffer));
+        has_saved_makeflags = length > 0 && length < sizeof(makeflags_buffer);
+        if (has_saved_makeflags) {
+            StrBuilder saved(get_global_allocator());
+            saved.append(makeflags_buffer, length);
+            saved.append_null(false);
+            saved_makeflags = saved.to_string_view(true);
+        }
+        SetEnvironmentVariableA("MAKEFLAGS", makeflags.data);
+    #else
+        fcntl(shared_read_fd, F_SETFD, 0);
+        fcntl(write_fd, F_SETFD, 0);
+        setenv("MAKEFLAGS", makeflags.data, 1);
+    #endif // !_WIN32
+    }
+
+    void JobServer::hide()
+    {
+        if (!is_owner) return;
+    #if defined(_WIN32)
+        SetEnvironmentVariableA("MAKEFLAGS", has_saved_makeflags ? saved_makeflags.data : NULL);
+    #else
+        fcntl(shared_read_fd, F_SETFD, FD_CLOEXEC);
+        fcntl(write_fd, F_SETFD, FD_CLOEXEC);
+        unsetenv("MAKEFLAGS");
+    #endif // !_WIN32
+    }
+
+    bool JobServer::try_acquire()
+    {
+    #if defined(_WIN32)
+        if (WaitForSingleObject(semaphore, 0) != WAIT_OBJECT_0) return false;
+        tokens.push('+');
+        return true;
+    #else
+        if (!is_read_nonblocking) {
+            // Token still can be taken by someone else after poll, then read waits for next one
+            pollfd descriptor = {read_fd, POLLIN, 0};
+            if (poll(&descriptor, 1, 0) <= 0) return false;
+        }
+        char token;
+        if (read(read_fd, &token, 1) != 1) return false;
+        tokens.push(token);
+        return true;
+    #endif // !_WIN32
+    }
+
+    void JobServer::release()
+    {
+        if (tokens.count() < 1) return;
+        const char token = tokens.pop();
+    #if defined(_WIN32)
+        UNUSED(token);
+        ReleaseSemaphore(semaphore, 1, NULL);
+    #else
+        // Lost token would make parent make run less jobs, so write is retried
+        while (write(write_fd, &token, 1) < 0 && errno == EINTR) {}
+    #endif // !_WIN32
+    }
+
+    void JobServer::cleanup()
+    {
+        while (tokens.count() > 0)
+            release();
+        tokens.cleanup();
+    #if defined(_WIN32)
+        if (semaphore != NULL) CloseHandle(semaphore);
+        semaphore = NULL;
+    #else
+        // Descriptors of parent make are left open, only reopened ones and own pipe are closed
+        if (is_read_nonblocking && read_fd >= 0) close(read_fd);
+        if ((is_owner || is_fifo) && write_fd >= 0) close(write_fd);
+        if (is_owner && shared_read_fd >= 0 && shared_read_fd != read_fd) close(shared_read_fd);
+        read_fd = -1;
+        write_fd = -1;
+        shared_read_fd = -1;
+        is_read_nonblocking = false;
+        is_fifo = false;
+    #endif // !_WIN32
+        is_owner = false;
+    }
+
+    JobServer* get_job_server(usize max_processes)
+    {
+    #if defined(EZBUILD_NO_JOBSERVER)
+        UNUSED(max_processes);
+        return nullptr;
+    #else
+        static JobServer job_server;
+        static bool is_initialized = false;
+        static bool is_available = false;
+        if (!is_initialized) {
+            is_initialized = true;
+        #if defined(EZBUILD_CREATE_JOBSERVER)
+            is_available = job_server.connect() || job_server.create(max_processes);
+        #else
+            UNUSED(max_processes);
+            is_available = job_server.connect();
+        #endif // !EZBUILD_CREATE_JOBSERVER
+        }
+        return is_available ? &job_server : nullptr;
+    #endif // !EZBUILD_NO_JOBSERVER
+    }
+
     bool Process::wait()
     {
         bool result = true;
@@ -1299,6 +2296,12 @@ namespace Sl
             DEFER_RETURN(false);
         }
 
+        exit_code = (s32)exit_status;
+        {
+            PROCESS_MEMORY_COUNTERS counters = {};
+            if (K32GetProcessMemoryInfo(id, &counters, sizeof(counters)))
+                peak_memory = counters.PeakWorkingSetSize;
+        }
         if (exit_status != 0) {
             log_error("Process 0x%zx exited with exit code %lu\n", (usize)id, exit_status);
             DEFER_RETURN(false);
@@ -1311,12 +2314,18 @@ namespace Sl
         }
     #else
         int status;
-        int exit_code;
+        struct rusage usage;
 
-        if (waitpid(id, &status, 0) < 0) {
+        memory_zero(&usage, sizeof(usage));
+        if (wait4(id, &status, 0, &usage) < 0) {
             report_error("Could not wait on process %d", id);
             DEFER_RETURN(false);
         }
+        #if defined(__APPLE__)
+            peak_memory = (u64)usage.ru_maxrss; // Bytes on macOS
+        #else
+            peak_memory = (u64)usage.ru_maxrss * 1024;
+        #endif // !__APPLE__
         if (WIFEXITED(status)) {
             exit_code = WEXITSTATUS(status);
             if (exit_code != 0) {
@@ -1325,11 +2334,11 @@ namespace Sl
             }
         }
         if (WIFSIGNALED(status)) {
+            exit_code = 128 + WTERMSIG(status); // Same as shells report it
             log_error("Command process was terminated by signal %d\n", WTERMSIG(status));
             DEFER_RETURN(false);
         }
     end:
-        close(id);
     #endif // !_WIN32
         done = true;
         if (!result) error_happened = true;
@@ -1371,6 +2380,7 @@ namespace Sl
                 if (startInfo.hStdError == INVALID_HANDLE_VALUE) log_warning("Could not get STD_ERROR_HANDLE\n");
             }
             startInfo.dwFlags = STARTF_USESTDHANDLES;
+            if (opt.job_server) opt.job_server->expose();
             success = CreateProcessW(NULL, (LPWSTR)utf8_to_utf16_windows(_data).data, NULL, NULL, TRUE, 0, NULL, NULL, &startInfo, &procInfo);
         } else {
             STARTUPINFOA startInfo;
@@ -1394,8 +2404,10 @@ namespace Sl
                 if (startInfo.hStdError == INVALID_HANDLE_VALUE) log_warning("Could not get STD_ERROR_HANDLE\n");
             }
             startInfo.dwFlags = STARTF_USESTDHANDLES;
+            if (opt.job_server) opt.job_server->expose();
             success = CreateProcessA(NULL, _data, NULL, NULL, TRUE, 0, NULL, NULL, &startInfo, &procInfo);
         }
+        if (opt.job_server) opt.job_server->hide();
         if (!success) {
             report_error("Could not create process \"" SV_FORMAT "\"", (int)_count, _data);
             if (opt.reset_command) reset();
@@ -1430,6 +2442,7 @@ namespace Sl
                     exit(EXIT_FAILURE);
                 }
             }
+            if (opt.job_server) opt.job_server->expose();
             usize size_out;
             StrView data_view(_data, _count);
             Allocator* alloc = get_global_allocator();
@@ -1694,9 +2707,20 @@ namespace Sl
             exit(EXIT_FAILURE);
         }
         _build_started = true;
-        this->incremental_build = opt.incremental_build;
+        this->is_cpp = opt.is_cpp;
+        this->executable_type = opt.type;
+        this->thin_archive = opt.thin_archive;
+        // Archiver needs objects, so there is no single command build for static library
+        this->incremental_build = opt.incremental_build || opt.type == FlagsExecutableType::STATIC_LIB;
+        this->single_pass_dependencies = opt.single_pass_dependencies;
+        this->content_hash = opt.content_hash;
+        this->unity_build = opt.unity_build;
+        this->unity_batches = opt.unity_batches;
         _custom_compiler = custom_compiler;
         const auto compiler = get_effective_compiler();
+        this->time_trace = opt.time_trace && compiler == FlagsCompiler::CLANG;
+        if (opt.time_trace && compiler != FlagsCompiler::CLANG)
+            log_warning("Time trace is supported only by Clang, it's disabled\n");
         if (custom_compiler.size > 0) {
             push(custom_compiler);
         } else {
@@ -1705,6 +2729,8 @@ namespace Sl
         }
         if (compiler == FlagsCompiler::MSVC)
             push("/nologo", "/EHsc");
+        else if (opt.type == FlagsExecutableType::DYNAMIC_LIB)
+            push("-fPIC");
 
         if (opt.debug) push_flag_debug(compiler);
         push_flag_warning(opt.warnings, compiler);
@@ -1897,15 +2923,74 @@ namespace Sl
 
     void Cmd::output_folder(StrView folder)
     {
+        forget_created_folders();
         _output_folder = folder;
     }
 
-    void Cmd::output_file(StrView file, bool contains_ext)
+    void Cmd::object_cache_folder(StrView folder)
+    {
+        _object_cache_folder = folder;
+    }
+
+    void Cmd::trace_file(StrView file)
+    {
+        _trace_file = file;
+    }
+
+    void Cmd::add_remote_worker(StrView address, StrView secret)
+    {
+        remote_workers.push(address);
+        remote_worker_secrets.push(secret);
+    }
+
+    void Cmd::add_precompiled_header(StrView header)
+    {
+        check_start_build();
+        if (_precompiled_header.size > 0)
+            log_warning("Only one precompiled header is supported, \"" SV_FORMAT "\" replaces \"" SV_FORMAT "\"\n", SV_ARG(header), SV_ARG(_precompiled_header));
+        _precompiled_header = header;
+    }
+
+    void Cmd::exclude_from_unity_build(StrView file)
+    {
+        unity_excluded_files.push(file);
+    }
+
+    void Cmd::output_file(StrView file, bool contains_ext)
     {
         output_name = file;
         output_contains_ext = contains_ext;
     }
 
+    static const char* get_output_extension(FlagsExecutableType type)
+    {
+        static_assert((int)FlagsExecutableType::EnumSize == 3, "Unhandled FlagsExecutableType type");
+        const auto system = get_system();
+        switch (type) {
+            case FlagsExecutableType::STATIC_LIB:
+                return system == FlagsSystem::WINDOWS ? ".lib" : ".a";
+            case FlagsExecutableType::DYNAMIC_LIB:
+                if (system == FlagsSystem::WINDOWS) return ".dll";
+                return system == FlagsSystem::MACOS ? ".dylib" : ".so";
+            default:
+                return system == FlagsSystem::WINDOWS ? ".exe" : "";
+        }
+    }
+
+    void Cmd::append_archive_command(FlagsCompiler compiler, StrView output_path)
+    {
+        check_start_build();
+        if (compiler == FlagsCompiler::MSVC) {
+            append("lib /nologo /OUT:");
+            append(output_path);
+        } else {
+            // r - insert with replacement, c - create silently, s - write symbol table, T - thin archive
+            append(thin_archive ? "ar rcsT " : "ar rcs ");
+            append(output_path);
+        }
+        append(' ');
+    }
+
     void Cmd::append_output_name(FlagsCompiler compiler, bool append_flag)
     {
         check_start_build();
@@ -1917,11 +3002,8 @@ namespace Sl
             append("./");
         }
         append(output_name.data, output_name.size);
-    #if defined(_WIN32)
-        if (!output_contains_ext) {
-            append(".exe");
-        }
-    #endif // !_WIN32
+        if (!output_contains_ext)
+            append(get_output_extension(executable_type));
         append(' ');
     }
 
@@ -1935,14 +3017,32 @@ namespace Sl
         return false;
     }
 
-    bool read_dependencies(StrView depency_path, Array<StrView>& depencies_out, StrView output_folder, StrView custom_compiler)
+    // Files generated into output folder (unity batches) keep their outputs next to them,
+    //  not in <output>/<output>/
+    static StrView strip_output_folder(StrView file, StrView output_folder)
+    {
+        if (output_folder.size > 0 && file.size > output_folder.size && file.starts_with(output_folder) && file.data[output_folder.size] == '/')
+            file.chop_left(output_folder.size + 1);
+        return file;
+    }
+
+    // Only extension at the end of file name is removed, folders like "lib.core/" are kept as they are.
+    //  Headers (precompiled ones) keep their extension
+    static StrView strip_cpp_postfix(StrView file)
     {
-        auto cpp_index = depency_path.find_last(".cpp");
-        if (cpp_index == StrView::INVALID_INDEX) {
-            cpp_index = depency_path.find_last(".c");
-            if (cpp_index == StrView::INVALID_INDEX) return false;
+        const StrView extensions[] = {".cpp", ".cc", ".cxx", ".c"};
+        for (auto& extension : extensions) {
+            if (file.size > extension.size && file.ends_with(extension)) {
+                file.chop_right(extension.size);
+                break;
+            }
         }
-        depency_path.chop_right(depency_path.size - cpp_index);
+        return file;
+    }
+
+    bool read_dependencies(StrView depency_path, Array<StrView>& depencies_out, StrView output_folder, StrView custom_compiler)
+    {
+        depency_path = strip_cpp_postfix(strip_output_folder(depency_path, output_folder));
 
         FileHandle depency;
         StrBuilder new_depency_path(get_global_allocator());
@@ -1971,7 +3071,37 @@ namespace Sl
         auto view = buffer.to_string_view();
         StrView start_dep_str = "";
         char end_dep_str;
-        if (compiler == FlagsCompiler::MSVC) {
+        auto json_view = view;
+        json_view.trim_left();
+        if (compiler == FlagsCompiler::MSVC && json_view.first() == '{') {
+            // JSON generated by /sourceDependencies, we only need "Includes" array
+            auto includes_index = json_view.find_first("\"Includes\"");
+            if (includes_index == StrView::INVALID_INDEX) return false;
+            json_view.chop_left(includes_index);
+            auto begin_index = json_view.find_first('[');
+            auto end_index = json_view.find_first(']');
+            if (begin_index == StrView::INVALID_INDEX || end_index == StrView::INVALID_INDEX || end_index < begin_index)
+                return false;
+            auto includes = json_view.sub_view(begin_index + 1, end_index);
+            do {
+                auto quote_index = includes.find_first('"');
+                if (quote_index == StrView::INVALID_INDEX) break;
+                includes.chop_left(quote_index + 1);
+                StrBuilder unescaped_path(get_global_allocator());
+                while (includes.size > 0 && includes.first() != '"') {
+                    char ch = includes.first();
+                    includes.chop_left(1);
+                    if (ch == '\\' && includes.size > 0) {
+                        ch = includes.first();
+                        includes.chop_left(1);
+                    }
+                    unescaped_path.append(ch);
+                }
+                if (includes.size > 0) includes.chop_left(1); // skip "
+                unescaped_path.append_null(false);
+                depencies_out.push(unescaped_path.to_string_view(true));
+            } while(includes.size > 0);
+        } else if (compiler == FlagsCompiler::MSVC) {
             start_dep_str = ":  ";
             end_dep_str = '\n';
             do {
@@ -2053,14 +3183,491 @@ namespace Sl
         return true;
     }
 
-    static bool compare_file_time_with_provided(StrView file, FileTimeUnit provided, s32& result_out, HashMap<StrView, FileTimeUnit, StrView::hash>* cache = nullptr)
+    // On-disk layout of BuildDatabase:
+    //   BuildDatabaseHeader
+    //   BuildDatabasePath[path_count]
+    //   BuildRecord[record_count]
+    //   u32[dependency_count]
+    //   char[strings_size] (every path is null terminated)
+    struct BuildDatabaseHeader
     {
-        if (cache) {
-            if (auto* time = cache->get(file)) {
-                result_out = compare_file_time(provided, *time);
-                return true;
+        u32 magic;
+        u32 version;
+        u32 time_size;
+        u32 path_count;
+        u32 record_count;
+        u32 dependency_count;
+        u32 strings_size;
+        u32 link_count;
+    };
+
+    struct BuildDatabasePath
+    {
+        u32 offset; // Offset into strings
+        u32 size;
+        BuildPathInfo info;
+    };
+
+    bool BuildDatabase::load(StrView output_folder)
+    {
+        cleanup();
+        StrBuilder path_builder(get_global_allocator());
+        path_builder.append(output_folder);
+        path_builder.append("/.ezbuild.db");
+        path_builder.append_null(false);
+        database_path = path_builder.to_string_view(true);
+
+        {
+            ScopedLogger _(logger_muted);
+            if (!map_file(database_path, mapping)) return false;
+        }
+        if (mapping.size < sizeof(BuildDatabaseHeader)) {
+            unmap_file(mapping);
+            return false;
+        }
+        const auto& header = *(const BuildDatabaseHeader*)mapping.data;
+        bool is_valid = header.magic == MAGIC
+                     && header.version == VERSION
+                     && header.time_size == sizeof(FileTimeUnit);
+        if (is_valid) {
+            const usize expected_size = sizeof(BuildDatabaseHeader)
+                                      + (usize)header.path_count * sizeof(BuildDatabasePath)
+                                      + (usize)header.record_count * sizeof(BuildRecord)
+                                      + (usize)header.link_count * sizeof(BuildLinkRecord)
+                                      + (usize)header.dependency_count * sizeof(u32)
+                                      + (usize)header.strings_size;
+            is_valid = expected_size == mapping.size;
+        }
+        if (!is_valid) {
+            log_warning("Build database \"" SV_FORMAT "\" is outdated or corrupted, it will be recreated\n", SV_ARG(database_path));
+            unmap_file(mapping);
+            return false;
+        }
+
+        const auto* stored_paths = (const BuildDatabasePath*)(mapping.data + sizeof(BuildDatabaseHeader));
+        const auto* stored_records = (const BuildRecord*)(stored_paths + header.path_count);
+        const auto* stored_links = (const BuildLinkRecord*)(stored_records + header.record_count);
+        const auto* stored_dependencies = (const u32*)(stored_links + header.link_count);
+        const auto* strings = (const char*)(stored_dependencies + header.dependency_count);
+
+        paths.reserve(header.path_count);
+        path_infos.reserve(header.path_count);
+        for (u32 i = 0; i < header.path_count; ++i) {
+            const auto& path = stored_paths[i];
+            if ((usize)path.offset + path.size >= header.strings_size) {
+                log_warning("Build database \"" SV_FORMAT "\" is corrupted, it will be recreated\n", SV_ARG(database_path));
+                cleanup();
+                return false;
+            }
+            StrView view(strings + path.offset, path.size, true, false);
+            paths.push(view);
+            path_infos.push(path.info);
+            path_ids.insert(view, i);
+        }
+        if (header.dependency_count > 0)
+            dependencies.push_many(stored_dependencies, header.dependency_count);
+        for (u32 i = 0; i < header.record_count; ++i) {
+            const auto& record = stored_records[i];
+            if (record.object_id >= header.path_count || record.source_id >= header.path_count
+                || (usize)record.first_dependency + record.dependency_count > header.dependency_count) {
+                log_warning("Build database \"" SV_FORMAT "\" is corrupted, it will be recreated\n", SV_ARG(database_path));
+                cleanup();
+                return false;
+            }
+            records.push(record);
+            record_ids.insert(records.last().object_id, i);
+        }
+        for (u32 i = 0; i < header.link_count; ++i) {
+            const auto& link = stored_links[i];
+            if (link.output_id >= header.path_count) {
+                log_warning("Build database \"" SV_FORMAT "\" is corrupted, it will be recreated\n", SV_ARG(database_path));
+                cleanup();
+                return false;
+            }
+            links.push(link);
+            link_ids.insert(links.last().output_id, i);
+        }
+        return true;
+    }
+
+    bool BuildDatabase::save()
+    {
+        if (!is_changed) {
+            cleanup();
+            return true;
+        }
+        // Only paths that are still referenced by records are written
+        Array<u32> new_ids = {};
+        new_ids.reserve(paths.count());
+        new_ids.set_count(paths.count());
+        for (auto& id : new_ids) id = INVALID_ID;
+
+        BuildDatabaseHeader header = {};
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.time_size = sizeof(FileTimeUnit);
+        auto remap = [&](u32 id) -> u32 {
+            if (new_ids[id] == INVALID_ID) {
+                new_ids[id] = header.path_count++;
+                header.strings_size += (u32)paths[id].size + 1;
+            }
+            return new_ids[id];
+        };
+        for (auto& record : records) {
+            remap(record.object_id);
+            remap(record.source_id);
+            for (u32 i = 0; i < record.dependency_count; ++i)
+                remap(dependencies[record.first_dependency + i]);
+            header.dependency_count += record.dependency_count;
+        }
+        for (auto& link : links)
+            remap(link.output_id);
+        header.record_count = (u32)records.count();
+        header.link_count = (u32)links.count();
+
+        StrBuilder buffer = {};
+        buffer.reserve(sizeof(BuildDatabaseHeader)
+                     + header.path_count * sizeof(BuildDatabasePath)
+                     + header.record_count * sizeof(BuildRecord)
+                     + header.link_count * sizeof(BuildLinkRecord)
+                     + header.dependency_count * sizeof(u32)
+                     + header.strings_size);
+        buffer.append((const char*)&header, sizeof(header));
+
+        // Paths in order of new ids
+        Array<u32> old_ids = {};
+        old_ids.reserve(header.path_count);
+        old_ids.set_count(header.path_count);
+        for (usize i = 0; i < new_ids.count(); ++i) {
+            if (new_ids[i] != INVALID_ID) old_ids[new_ids[i]] = (u32)i;
+        }
+        u32 offset = 0;
+        for (auto old_id : old_ids) {
+            BuildDatabasePath path = {};
+            path.offset = offset;
+            path.size = (u32)paths[old_id].size;
+            path.info = path_infos[old_id];
+            buffer.append((const char*)&path, sizeof(path));
+            offset += path.size + 1;
+        }
+        u32 first_dependency = 0;
+        for (auto& record : records) {
+            BuildRecord new_record = record;
+            new_record.object_id = new_ids[record.object_id];
+            new_record.source_id = new_ids[record.source_id];
+            new_record.first_dependency = first_dependency;
+            first_dependency += record.dependency_count;
+            buffer.append((const char*)&new_record, sizeof(new_record));
+        }
+        for (auto& link : links) {
+            BuildLinkRecord new_link = link;
+            new_link.output_id = new_ids[link.output_id];
+            buffer.append((const char*)&new_link, sizeof(new_link));
+        }
+        for (auto& record : records) {
+            for (u32 i = 0; i < record.dependency_count; ++i) {
+                const u32 id = new_ids[dependencies[record.first_dependency + i]];
+                buffer.append((const char*)&id, sizeof(id));
+            }
+        }
+        for (auto old_id : old_ids) {
+            buffer.append(paths[old_id]);
+            buffer.append('\0');
+        }
+        new_ids.cleanup();
+        old_ids.cleanup();
+
+        StrBuilder temp_path(get_global_allocator());
+        temp_path.append(database_path);
+        temp_path.append(".tmp");
+        temp_path.append_null(false);
+
+        bool result = false;
+        FileHandle file = INVALID_FILE_HANDLE;
+        if (create_file(temp_path.to_string_view(true), file)) {
+            result = write_to_file(file, buffer.data(), buffer.count());
+            close_file(file);
+        }
+        buffer.cleanup();
+        // Mapped file must be released before it can be replaced (on Windows)
+        cleanup();
+        if (result) result = rename_file(temp_path.to_string_view(true), database_path);
+        if (!result) log_error("Could not save build database \"" SV_FORMAT "\"\n", SV_ARG(database_path));
+        return result;
+    }
+
+    void BuildDatabase::cleanup()
+    {
+        paths.cleanup();
+        path_infos.cleanup();
+        path_states.cleanup();
+        nodes.cleanup();
+        dependents_offsets.cleanup();
+        dependents.cleanup();
+        is_reverse_index_valid = false;
+        dependencies.cleanup();
+        records.cleanup();
+        links.cleanup();
+        path_ids.cleanup();
+        record_ids.cleanup();
+        link_ids.cleanup();
+        if (mapping.file != INVALID_FILE_HANDLE) unmap_file(mapping);
+        is_changed = false;
+    }
+
+    u32 BuildDatabase::find_path(StrView path)
+    {
+        auto* id = path_ids.get(path);
+        return id ? *id : INVALID_ID;
+    }
+
+    u32 BuildDatabase::intern_path(StrView path)
+    {
+        auto id = find_path(path);
+        if (id != INVALID_ID) return id;
+
+        StrView copy((const char*)memory_duplicate(*get_global_allocator(), path.data, path.size), path.size, true, path.is_wide);
+        id = (u32)paths.count();
+        paths.push(copy);
+        path_infos.push(BuildPathInfo{});
+        path_ids.insert(copy, id);
+        return id;
+    }
+
+    BuildRecord* BuildDatabase::find_record(StrView object)
+    {
+        const auto object_id = find_path(object);
+        if (object_id == INVALID_ID) return nullptr;
+        auto* index = record_ids.get(object_id);
+        return index ? &records[*index] : nullptr;
+    }
+
+    BuildLinkRecord* BuildDatabase::find_link(StrView output)
+    {
+        const auto output_id = find_path(output);
+        if (output_id == INVALID_ID) return nullptr;
+        auto* index = link_ids.get(output_id);
+        return index ? &links[*index] : nullptr;
+    }
+
+    void BuildDatabase::update_link(StrView output, u64 command_hash)
+    {
+        BuildLinkRecord link = {};
+        link.output_id = intern_path(output);
+        link.command_hash = command_hash;
+        if (auto* index = link_ids.get(link.output_id)) {
+            links[*index] = link;
+        } else {
+            links.push(link);
+            link_ids.insert(link.output_id, (u32)(links.count() - 1));
+        }
+        is_changed = true;
+    }
+
+    FileStat FileStatCache::get(StrView path)
+    {
+        if (auto* stat = stats.get(path)) return *stat;
+        FileStat result = {};
+        StrBuilder builder(get_global_allocator());
+        bool is_wide = path.is_wide;
+        const char* file_path = normalize_path(builder, path, is_wide);
+        ++stat_calls;
+    #ifdef _WIN32
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        BOOL found = is_wide ? GetFileAttributesExW((LPCWSTR)file_path, GetFileExInfoStandard, &data)
+                             : GetFileAttributesExA(file_path, GetFileExInfoStandard, &data);
+        if (found) {
+            result.exists = true;
+            result.time = data.ftLastWriteTime;
+            result.size = ((u64)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+        }
+    #elif defined(__linux__) && defined(STATX_MTIME)
+        // Only requested fields are fetched, which is cheaper on network file systems
+        struct statx st;
+        if (statx(AT_FDCWD, file_path, AT_STATX_SYNC_AS_STAT, STATX_MTIME | STATX_SIZE, &st) == 0) {
+            result.exists = true;
+            result.time = FileTimeUnit{(s64)st.stx_mtime.tv_sec, (s64)st.stx_mtime.tv_nsec};
+            result.size = (u64)st.stx_size;
+        }
+    #else
+        struct stat st;
+        if (stat(file_path, &st) == 0) {
+            result.exists = true;
+            result.time = to_file_time(EZBUILD_STAT_TIME(st, m));
+            result.size = (u64)st.st_size;
+        }
+    #endif // !_WIN32
+        // Path can point into temporary buffer of the caller
+        auto* key = (char*)keys.allocate(path.size + 1, 1);
+        memory_copy(key, path.size + 1, path.data, path.size);
+        key[path.size] = '\0';
+        StrView key_view(key, path.size, true, false);
+        stats.insert(key_view, result);
+        return result;
+    }
+    bool FileStatCache::exists(StrView path)
+    {
+        return get(path).exists;
+    }
+    bool FileStatCache::get_time(StrView path, FileTimeUnit& time_out)
+    {
+        const auto stat = get(path);
+        if (stat.exists) time_out = stat.time;
+        return stat.exists;
+    }
+    bool FileStatCache::get_size(StrView path, u64& size_out)
+    {
+        const auto stat = get(path);
+        if (stat.exists) size_out = stat.size;
+        return stat.exists;
+    }
+    void FileStatCache::invalidate(StrView path)
+    {
+        stats.remove(path);
+    }
+    void FileStatCache::clear()
+    {
+        stats.clear();
+        keys.reset();
+    }
+    void FileStatCache::cleanup()
+    {
+        stats.cleanup();
+        keys.cleanup();
+    }
+
+    static bool get_file_time_and_size(StrView file, FileTimeUnit& time_out, usize& size_out)
+    {
+        FileHandle file_handle;
+        if (!open_file(file, file_handle)) return false;
+        FileTime file_time;
+        bool result = get_file_time(file_handle, file_time) && get_file_size(file_handle, size_out);
+        close_file(file_handle);
+        time_out = file_time.last_write_time;
+        return result;
+    }
+
+    static bool hash_file_content(StrView file, u64& digest_out)
+    {
+        FileMapping mapping;
+        if (!map_file(file, mapping)) return false;
+        digest_out = hasher_fn_default(0, mapping.data, mapping.size);
+        if (digest_out == 0) digest_out = 1; // 0 means unknown
+        unmap_file(mapping);
+        return true;
+    }
+
+    Result BuildDatabase::check_content(u32 path_id)
+    {
+        const s8 NOT_CHECKED = (s8)(SL_ERROR - 1);
+        while (path_states.count() < paths.count())
+            path_states.push(NOT_CHECKED);
+        if (path_states[path_id] != NOT_CHECKED) return (Result)path_states[path_id];
+
+        ScopedLogger _(logger_muted);
+        Result result = SL_ERROR;
+        auto& info = path_infos[path_id];
+        FileTimeUnit time;
+        u64 size;
+        bool found;
+        if (stat_cache) found = stat_cache->get_time(paths[path_id], time) && stat_cache->get_size(paths[path_id], size);
+        else {
+            usize file_size = 0;
+            found = get_file_time_and_size(paths[path_id], time, file_size);
+            size = file_size;
+        }
+        if (found) {
+            if (info.digest != 0 && info.size == size && compare_file_time(info.time, time) == 0) {
+                result = SL_FALSE;
+            } else {
+                u64 digest;
+                if (hash_file_content(paths[path_id], digest)) {
+                    if (info.digest != 0)
+                        result = info.digest == digest ? SL_FALSE : SL_TRUE;
+                    info.time = time;
+                    info.size = size;
+                    info.digest = digest;
+                    is_changed = true;
+                }
             }
         }
+        path_states[path_id] = (s8)result;
+        return result;
+    }
+
+    void BuildDatabase::update_record(StrView object, StrView source, Array<StrView>& dependencies_list, FileTimeUnit object_time, u64 command_hash)
+    {
+        BuildRecord record = {};
+        record.object_id = intern_path(object);
+        record.source_id = intern_path(source);
+        record.first_dependency = (u32)dependencies.count();
+        record.dependency_count = (u32)dependencies_list.count();
+        record.command_hash = command_hash;
+        record.object_time = object_time;
+        // Old dependency list is left unreferenced, it's dropped on save()
+        for (auto& dependency : dependencies_list)
+            dependencies.push(intern_path(dependency));
+
+        if (auto* index = record_ids.get(record.object_id)) {
+            records[*index] = record;
+        } else {
+            records.push(record);
+            record_ids.insert(record.object_id, (u32)(records.count() - 1));
+        }
+        is_changed = true;
+        is_reverse_index_valid = false;
+    }
+
+    void BuildDatabase::find_dependents(u32 path_id, Array<u32>& records_out)
+    {
+        if (!is_reverse_index_valid) {
+            // Edges (path -> record) are grouped by path with counting sort
+            auto for_each_edge = [&](auto&& callback) {
+                for (u32 index = 0; index < (u32)records.count(); ++index) {
+                    auto& record = records[index];
+                    callback(record.source_id, index);
+                    for (u32 i = 0; i < record.dependency_count; ++i)
+                        callback(dependencies[record.first_dependency + i], index);
+                }
+            };
+            dependents_offsets.set_count(0);
+            for (usize i = 0; i <= paths.count(); ++i)
+                dependents_offsets.push(0u);
+            for_each_edge([&](u32 id, u32) { ++dependents_offsets[id + 1]; });
+            for (usize i = 1; i < dependents_offsets.count(); ++i)
+                dependents_offsets[i] += dependents_offsets[i - 1];
+            dependents.reserve(dependents_offsets.last());
+            dependents.set_count(dependents_offsets.last());
+            Array<u32> positions(get_global_allocator());
+            positions.push_many(dependents_offsets.data(), dependents_offsets.count());
+            for_each_edge([&](u32 id, u32 index) { dependents[positions[id]++] = index; });
+            is_reverse_index_valid = true;
+        }
+        // Path could be interned after index was made, nothing depends on it then
+        if ((usize)path_id + 1 >= dependents_offsets.count()) return;
+        for (u32 i = dependents_offsets[path_id]; i < dependents_offsets[path_id + 1]; ++i)
+            records_out.push(dependents[i]);
+    }
+
+    void BuildDatabase::find_affected_sources(const Array<u32>& path_ids, Array<StrView>& sources_out)
+    {
+        Array<u32> affected_records(get_global_allocator());
+        for (usize i = 0; i < path_ids.count(); ++i)
+            find_dependents(path_ids.data()[i], affected_records);
+        Array<bool> is_listed(get_global_allocator());
+        for (usize i = 0; i < paths.count(); ++i)
+            is_listed.push(false);
+        for (auto index : affected_records) {
+            const auto source_id = records[index].source_id;
+            if (is_listed[source_id]) continue;
+            is_listed[source_id] = true;
+            sources_out.push(paths[source_id]);
+        }
+    }
+
+    static bool get_file_write_time(StrView file, FileTimeUnit& time_out, FileStatCache* cache = nullptr)
+    {
+        if (cache) return cache->get_time(file, time_out);
         FileHandle file_handle;
         if (!open_file(file, file_handle)) return false;
         FileTime file_time;
@@ -2068,42 +3675,53 @@ namespace Sl
             close_file(file_handle);
             return false;
         }
-        FileTimeUnit src_time = file_time.last_write_time;
+        time_out = file_time.last_write_time;
         close_file(file_handle);
+        return true;
+    }
+
+    static bool compare_file_time_with_provided(StrView file, FileTimeUnit provided, s32& result_out, FileStatCache* cache = nullptr)
+    {
+        FileTimeUnit src_time;
+        if (!get_file_write_time(file, src_time, cache)) return false;
         result_out = compare_file_time(provided, src_time);
-        if (cache) cache->insert(file, src_time);
         return true;
     }
 
-    Result file_needs_rebuilt_cpp(StrView obj, StrView src_file, StrView output_folder, StrView custom_compiler, HashMap<StrView, FileTimeUnit, StrView::hash>* memoization)
+    BuildNode BuildDatabase::get_node(u32 path_id)
     {
-        ASSERT(obj.data != nullptr && obj.size > 0, "Provide correct object file path");
-        ASSERT(src_file.data != nullptr && src_file.size > 0, "Provide correct source file path");
+        while (nodes.count() < paths.count())
+            nodes.push(BuildNode{});
+        auto& node = nodes[path_id];
+        if (node.state != BuildNode::NOT_CHECKED) return node;
 
         ScopedLogger _(logger_muted);
-        FileHandle obj_handle = INVALID_FILE_HANDLE;
-        if (!open_file(obj, obj_handle)) return Result::SL_ERROR;
-
-        FileTime file_time = {};
-        if (!get_file_time(obj_handle, file_time)) {
-            close_file(obj_handle);
-            return Result::SL_ERROR;
+        if (!get_file_write_time(paths[path_id], node.time, stat_cache)) {
+            node.state = BuildNode::MISSING;
+            return node;
         }
-        FileTimeUnit obj_time = file_time.last_write_time;
-        close_file(obj_handle);
-
-        s32 compare;
-        if (!compare_file_time_with_provided(src_file, obj_time, compare))
-            return Result::SL_TRUE;
-        if (compare < 0)
-            return Result::SL_TRUE;
+        node.state = BuildNode::FOUND;
+        // Build without content hash doesn't hash changed file, so its old hash must not be trusted by next build with it
+        auto& info = path_infos[path_id];
+        if (!use_content_hash && info.digest != 0 && compare_file_time(info.time, node.time) != 0) {
+            info.digest = 0;
+            is_changed = true;
+        }
+        return node;
+    }
 
+    // Reads dependencies of C/C++ file and removes escaping of spaces from them
+    static bool read_unescaped_dependencies(StrView src_file, Array<StrView>& dependencies_out, StrView output_folder, StrView custom_compiler)
+    {
         Array<StrView> deps(get_global_allocator());
-        if (!read_dependencies(src_file, deps, output_folder, custom_compiler)) return Result::SL_ERROR;
+        if (!read_dependencies(src_file, deps, output_folder, custom_compiler)) return false;
 
-        StrBuilder escaped_dependency(get_global_allocator());
         for (auto& dependency : deps) {
-            escaped_dependency.clear();
+            if (dependency.find_first("\\ ") == StrView::INVALID_INDEX) {
+                dependencies_out.push(dependency);
+                continue;
+            }
+            StrBuilder escaped_dependency(get_global_allocator());
             do {
                 auto index = dependency.find_first("\\ ");
                 if (index == StrView::INVALID_INDEX) {
@@ -2115,43 +3733,2141 @@ namespace Sl
                 escaped_dependency.append(' ');
                 dependency.chop_left(2);
             } while(true);
-            auto dependency_view = escaped_dependency.to_string_view(true);
-            s32 compare;
-            if (!compare_file_time_with_provided(dependency_view, obj_time, compare, memoization))
+            dependencies_out.push(escaped_dependency.to_string_view(true));
+        }
+        return true;
+    }
+
+    Result file_needs_rebuilt_cpp(StrView obj, StrView src_file, StrView output_folder, StrView custom_compiler, FileStatCache* stat_cache, BuildDatabase* database)
+    {
+        ASSERT(obj.data != nullptr && obj.size > 0, "Provide correct object file path");
+        ASSERT(src_file.data != nullptr && src_file.size > 0, "Provide correct source file path");
+
+        ScopedLogger _(logger_muted);
+        FileTimeUnit obj_time;
+        if (!get_file_write_time(obj, obj_time, stat_cache)) return Result::SL_ERROR;
+
+        const bool use_content_hash = database && database->use_content_hash;
+        s32 compare;
+        if (!compare_file_time_with_provided(src_file, obj_time, compare, stat_cache))
+            return Result::SL_TRUE;
+        if (use_content_hash) {
+            auto content = database->check_content(database->intern_path(src_file));
+            if (content == Result::SL_TRUE || (content == Result::SL_ERROR && compare < 0))
+                return Result::SL_TRUE;
+        } else if (compare < 0)
+            return Result::SL_TRUE;
+
+        Array<StrView> deps(get_global_allocator());
+        Array<u32> dependency_ids(get_global_allocator());
+        auto* record = database ? database->find_record(obj) : nullptr;
+        if (record && compare_file_time(record->object_time, obj_time) == 0) {
+            // Object wasn't changed since it was recorded, so dependencies are still the same
+            for (u32 i = 0; i < record->dependency_count; ++i) {
+                const auto id = database->dependencies[record->first_dependency + i];
+                dependency_ids.push(id);
+                deps.push(database->paths[id]);
+            }
+        } else {
+            if (!read_unescaped_dependencies(src_file, deps, output_folder, custom_compiler)) return Result::SL_ERROR;
+            if (database) {
+                const auto command_hash = record ? record->command_hash : 0;
+                database->update_record(obj, src_file, deps, obj_time, command_hash);
+                record = database->find_record(obj);
+                for (u32 i = 0; i < record->dependency_count; ++i)
+                    dependency_ids.push(database->dependencies[record->first_dependency + i]);
+            }
+        }
+
+        // With database every dependency is a shared node of dependency graph, which is checked once per build,
+        //  no matter how many files include it
+        for (usize i = 0; i < deps.count(); ++i) {
+            FileTimeUnit dependency_time;
+            if (database) {
+                const auto node = database->get_node(dependency_ids[i]);
+                if (node.state == BuildNode::MISSING) return Result::SL_TRUE;
+                dependency_time = node.time;
+            } else if (!get_file_write_time(deps[i], dependency_time, stat_cache))
                 return Result::SL_TRUE;
-            if (compare < 0)
+            // Clean node still can be newer than object, which failed to compile last time
+            const bool is_newer = compare_file_time(obj_time, dependency_time) < 0;
+            if (use_content_hash) {
+                auto content = database->check_content(dependency_ids[i]);
+                if (content == Result::SL_TRUE || (content == Result::SL_ERROR && is_newer))
+                    return Result::SL_TRUE;
+                continue;
+            }
+            if (is_newer)
                 return Result::SL_TRUE;
         }
         return Result::SL_FALSE;
     }
 
-    static StrView strip_cpp_postfix(StrView file)
+    static StrView get_dependency_path(StrBuilder& buffer, StrView file, FlagsCompiler compiler, StrView output_folder)
+    {
+        buffer.clear();
+        buffer.append(output_folder);
+        buffer.append('/');
+        buffer.append(strip_cpp_postfix(strip_output_folder(file, output_folder)));
+        if (compiler == FlagsCompiler::MSVC)
+            buffer.append("_cl.d");
+        else
+            buffer.append(".d");
+        buffer.append_null(false);
+        return buffer.to_string_view(true);
+    }
+
+    static StrView get_object_path(StrBuilder& buffer, StrView file, StrView output_folder)
+    {
+        buffer.clear();
+        buffer.append(output_folder);
+        buffer.append('/');
+        buffer.append(strip_output_folder(file, output_folder));
+        buffer.append(".obj");
+        buffer.append_null(false);
+        return buffer.to_string_view(true);
+    }
+
+    // <output>/<header>.gch for GCC (it looks for it next to forcibly included <output>/<header>), .pch for others
+    static StrView get_precompiled_header_path(StrBuilder& buffer, StrView header, FlagsCompiler compiler, StrView output_folder)
+    {
+        buffer.clear();
+        buffer.append(output_folder);
+        buffer.append('/');
+        buffer.append(header);
+        if (compiler == FlagsCompiler::GCC)
+            buffer.append(".gch");
+        else
+            buffer.append(".pch");
+        buffer.append_null(false);
+        return buffer.to_string_view(true);
+    }
+
+    static u64 get_current_process_id()
+    {
+    #ifdef _WIN32
+        return (u64)GetCurrentProcessId();
+    #else
+        return (u64)getpid();
+    #endif // !_WIN32
+    }
+
+    // Local object cache works like "direct mode" of ccache:
+    //  <cache>/<manifest key>.manifest - dependencies that were used last time to compile the source with the same command and compiler
+    //  <cache>/<result key>.obj (.d)   - object and its dependency file, result key also includes content of every dependency
+    static StrView get_cache_path(StrBuilder& buffer, StrView cache_folder, u64 key, StrView extension)
+    {
+        buffer.clear();
+        buffer.append(cache_folder);
+        buffer.appendf("/%016llx", (unsigned long long)key);
+        buffer.append(extension);
+        buffer.append_null(false);
+        return buffer.to_string_view(true);
+    }
+
+    // Compiler given by name is looked up in PATH, the same way as process is started by it
+    static bool find_program_file(StrView program, StrBuilder& path_out, FileTimeUnit& time_out, usize& size_out)
+    {
+        path_out.clear();
+        path_out.append(program);
+        path_out.append_null(false);
+        if (program.find_last_of_chars("/\\") != StrView::INVALID_INDEX)
+            return get_file_time_and_size(path_out.to_string_view(true), time_out, size_out);
+    #if defined(_WIN32)
+        const char separator = ';';
+        const StrView extension = program.ends_with(".exe") ? "" : ".exe";
+    #else
+        const char separator = ':';
+        const StrView extension = "";
+    #endif // _WIN32
+        const char* path_env = getenv("PATH");
+        StrView folders = path_env ? StrView(path_env) : StrView("");
+        while (folders.size > 0) {
+            auto folder = folders;
+            const auto separator_index = folders.find_first(separator);
+            if (separator_index == StrView::INVALID_INDEX) {
+                folders.chop_left(folders.size);
+            } else {
+                folder.chop_right(folder.size - separator_index);
+                folders.chop_left(separator_index + 1);
+            }
+            if (folder.size == 0) continue;
+            path_out.clear();
+            path_out.append(folder);
+            path_out.append('/');
+            path_out.append(program);
+            path_out.append(extension);
+            path_out.append_null(false);
+            if (get_file_time_and_size(path_out.to_string_view(true), time_out, size_out)) return true;
+        }
+        return false;
+    }
+
+    // Output of "--version" (or banner of cl) identifies compiler, so cache isn't reused after compiler update.
+    //  It's stored in cache folder together with path, size and write time of compiler's binary,
+    //  so compiler is started again only after that binary is changed
+    static u64 get_compiler_identity(StrView compiler_name, FlagsCompiler compiler, StrView cache_folder)
+    {
+        ScopedLogger _(logger_muted);
+        u64 identity = hasher_fn_default(0, compiler_name.data, compiler_name.size);
+        StrBuilder compiler_path(get_global_allocator());
+        FileTimeUnit compiler_time;
+        usize compiler_size = 0;
+        if (!find_program_file(compiler_name, compiler_path, compiler_time, compiler_size)) return identity;
+        const auto compiler_path_view = compiler_path.to_string_view();
+        u64 stamp = hasher_fn_default(0, compiler_path_view.data, compiler_path_view.size);
+        stamp = hasher_fn_default(stamp, &compiler_size, sizeof(compiler_size));
+        stamp = hasher_fn_default(stamp, &compiler_time, sizeof(compiler_time));
+
+        // Every line is "<stamp> <identity>"
+        StrBuilder stored_path(get_global_allocator());
+        stored_path.append(cache_folder);
+        stored_path.appendf("/compiler-%016llx.identity", (unsigned long long)hasher_fn_default(0, compiler_path_view.data, compiler_path_view.size));
+        stored_path.append_null(false);
+        StrBuilder stored(get_global_allocator());
+        if (read_entire_file(stored_path.to_string_view(true), stored)) {
+            stored.append_null(false);
+            unsigned long long stored_stamp = 0;
+            unsigned long long stored_identity = 0;
+            if (sscanf(stored.data(), "%llx %llx", &stored_stamp, &stored_identity) == 2 && stored_stamp == stamp)
+                return stored_identity;
+        }
+
+        StrBuilder identity_path(get_global_allocator());
+        identity_path.append(cache_folder);
+        identity_path.appendf("/compiler.%llu.identity", (unsigned long long)get_current_process_id());
+        identity_path.append_null(false);
+        FileHandle output;
+        if (!create_file(identity_path.to_string_view(true), output, false, FlagsFile::FILE_OPEN_READ_WRITE)) return identity;
+        Cmd cmd = {};
+        cmd.push(compiler_name);
+        if (compiler != FlagsCompiler::MSVC) cmd.push("--version");
+        CmdOptions options = {};
+        options.print_command = false;
+        options.stdout_desc = &output;
+        options.stderr_desc = &output;
+        cmd.execute(options).wait();
+        close_file(output);
+
+        StrBuilder content(get_global_allocator());
+        if (read_entire_file(identity_path.to_string_view(true), content))
+            identity = hasher_fn_default(identity, content.data(), content.count());
+        // Written to temporary file first, so other build never reads half written identity
+        content.clear();
+        content.appendf("%016llx %016llx\n", (unsigned long long)stamp, (unsigned long long)identity);
+        FileHandle stored_file;
+        if (create_file(identity_path.to_string_view(true), stored_file)) {
+            const bool written = write_to_file(stored_file, content.data(), content.count());
+            close_file(stored_file);
+            if (written && rename_file(identity_path.to_string_view(true), stored_path.to_string_view(true))) return identity;
+        }
+        delete_file(identity_path.to_string_view(true));
+        return identity;
+    }
+
+    // Content is hashed here instead of BuildDatabase::check_content(), so computing key doesn't change
+    //  what incremental build knows about the files
+    static bool get_cache_manifest_key(u64 command_hash, u64 compiler_identity, StrView source, u64& key_out)
+    {
+        u64 digest;
+        if (!hash_file_content(source, digest)) return false;
+        u64 key = hasher_fn_default(command_hash, &compiler_identity, sizeof(compiler_identity));
+        key = hasher_fn_default(key, source.data, source.size);
+        key_out = hasher_fn_default(key, &digest, sizeof(digest));
+        return true;
+    }
+
+    static bool get_cache_result_key(u64 manifest_key, Array<StrView>& dependencies, u64& key_out)
+    {
+        u64 key = manifest_key;
+        for (auto& dependency : dependencies) {
+            u64 digest;
+            if (!hash_file_content(dependency, digest)) return false;
+            key = hasher_fn_default(key, dependency.data, dependency.size);
+            key = hasher_fn_default(key, &digest, sizeof(digest));
+        }
+        key_out = key;
+        return true;
+    }
+
+    static bool object_cache_fetch(StrView cache_folder, u64 manifest_key, StrView object_path, StrView dependency_path)
+    {
+        ScopedLogger _(logger_muted);
+        StrBuilder path(get_global_allocator());
+        StrBuilder manifest(get_global_allocator());
+        if (!read_entire_file(get_cache_path(path, cache_folder, manifest_key, ".manifest"), manifest)) return false;
+
+        Array<StrView> dependencies(get_global_allocator());
+        auto view = manifest.to_string_view();
+        while (view.size > 0) {
+            auto line = view.chop_left_by_delimeter("\n");
+            line.trim_right_char('\n');
+            if (line.size > 0) dependencies.push(line);
+        }
+        u64 result_key;
+        if (!get_cache_result_key(manifest_key, dependencies, result_key)) return false;
+        if (!copy_file(get_cache_path(path, cache_folder, result_key, ".obj"), object_path)) return false;
+        if (!copy_file(get_cache_path(path, cache_folder, result_key, ".d"), dependency_path)) {
+            delete_file(object_path);
+            return false;
+        }
+        return true;
+    }
+
+    static void object_cache_store(StrView cache_folder, u64 manifest_key, Array<StrView>& dependencies, StrView object_path, StrView dependency_path)
+    {
+        ScopedLogger _(logger_muted);
+        u64 result_key;
+        if (!get_cache_result_key(manifest_key, dependencies, result_key)) return;
+
+        // Everything is written under temporary name first, so concurrent builds never see partially written entry
+        StrBuilder temp_path(get_global_allocator());
+        auto make_temp_path = [&](StrView path) -> StrView {
+            temp_path.clear();
+            temp_path.append(path);
+            temp_path.appendf(".%llu.tmp", (unsigned long long)get_current_process_id());
+            temp_path.append_null(false);
+            return temp_path.to_string_view(true);
+        };
+        StrBuilder path(get_global_allocator());
+        auto store = [&](StrView from, StrView to) -> bool {
+            const auto temp = make_temp_path(to);
+            if (!copy_file(from, temp)) {
+                delete_file(temp);
+                return false;
+            }
+            return rename_file(temp, to);
+        };
+        // Dependency file goes first, since object file is what marks entry as present
+        if (!store(dependency_path, get_cache_path(path, cache_folder, result_key, ".d"))) return;
+        if (!store(object_path, get_cache_path(path, cache_folder, result_key, ".obj"))) return;
+
+        StrBuilder manifest(get_global_allocator());
+        for (auto& dependency : dependencies) {
+            manifest.append(dependency);
+            manifest.append('\n');
+        }
+        const auto manifest_path = get_cache_path(path, cache_folder, manifest_key, ".manifest");
+        const auto temp = make_temp_path(manifest_path);
+        FileHandle file;
+        if (!create_file(temp, file)) return;
+        bool result = write_to_file(file, manifest.data(), manifest.count());
+        close_file(file);
+        if (result) rename_file(temp, manifest_path);
+        else delete_file(temp);
+    }
+
+    // Remembers for which source file process was started
+    struct SourceJob
+    {
+        static const usize INVALID_INDEX = -1;
+        ProcessID id;
+        usize source_index;
+    };
+
+    // Removes job of provided process and returns its source index
+    static usize take_source_job(Array<SourceJob>& jobs, ProcessID id)
+    {
+        for (usize i = 0; i < jobs.count(); ++i) {
+            if (jobs[i].id == id) {
+                const auto index = jobs[i].source_index;
+                jobs.remove_unordered(i);
+                return index;
+            }
+        }
+        return SourceJob::INVALID_INDEX;
+    }
+
+    void Cmd::build_tree_of_folders(StrView file)
+    {
+        file = strip_output_folder(file, _output_folder);
+        const auto slash_index = file.find_last('/');
+        if (slash_index == StrView::INVALID_INDEX) return;
+        const StrView folder(file.data, slash_index);
+        if (created_folders.get(folder)) return;
+    #if !defined(_WIN32)
+        if (_output_folder_fd < 0) {
+            create_folder(_output_folder);
+            StrBuilder output_folder_path(get_global_allocator());
+            output_folder_path.append(_output_folder);
+            output_folder_path.append_null(false);
+            _output_folder_fd = open(output_folder_path.data(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        }
+    #endif // !_WIN32
+        // Parent folders go first, every one of them is remembered
+        for (usize end = 1; end <= folder.size; ++end) {
+            if (end < folder.size && folder.data[end] != '/') continue;
+            const StrView parent(folder.data, end);
+            if (created_folders.get(parent)) continue;
+            auto relative = parent;
+            relative.trim_left_char('/');
+            if (relative.size > 0) {
+                StrBuilder path(get_global_allocator());
+            #if !defined(_WIN32)
+                path.append(relative);
+                path.append_null(false);
+                // Existing folder is the usual case, so it costs only one failed mkdirat
+                if (_output_folder_fd < 0 || (mkdirat(_output_folder_fd, path.data(), 0755) != 0 && errno != EEXIST)) {
+                    path.reset();
+            #endif // !_WIN32
+                    path.append(_output_folder);
+                    path.append('/');
+                    path.append(relative);
+                    path.append_null(false);
+                    create_folder(path.to_string_view(true));
+            #if !defined(_WIN32)
+                }
+            #endif // !_WIN32
+            }
+            StrBuilder key(get_global_allocator());
+            key.append(parent);
+            key.append_null(false);
+            created_folders.insert(key.to_string_view(true), true);
+        }
+    }
+
+    void Cmd::forget_created_folders()
+    {
+        created_folders.clear();
+    #if !defined(_WIN32)
+        if (_output_folder_fd >= 0) close(_output_folder_fd);
+        _output_folder_fd = -1;
+    #endif // !_WIN32
+    }
+
+    static StrView get_unity_source_path(StrView output_folder, usize batch, bool is_cpp)
+    {
+        StrBuilder path(get_global_allocator());
+        path.append(output_folder);
+        path.appendf(is_cpp ? "/unity_%zu.cpp" : "/unity_%zu.c", batch);
+        path.append_null(false);
+        return path.to_string_view(true);
+    }
+
+    static bool write_file_if_changed(StrView path, StrView content)
+    {
+        // Unchanged file keeps its write time
+        StrBuilder old_content(get_global_allocator());
+        {
+            ScopedLogger _(logger_muted);
+            if (read_entire_file(path, old_content) && old_content.to_string_view() == content)
+                return true;
+        }
+        FileHandle file;
+        if (!create_file(path, file)) return false;
+        bool result = write_to_file(file, content.data, content.size);
+        close_file(file);
+        return result;
+    }
+
+    bool Cmd::plan_unity_build(BuildDatabase& database, FileStatCache* stat_cache, u64 command_hash,
+                               Array<bool>& stale_sources, Array<StrView>& compile_files_out, Array<StrView>& link_objects_out)
+    {
+        auto add_object = [&](StrView file) {
+            StrBuilder object_path(get_global_allocator());
+            link_objects_out.push(get_object_path(object_path, file, _output_folder));
+        };
+        auto add_separate_object = [&](usize index) {
+            if (stale_sources[index]) compile_files_out.push(source_files[index]);
+            add_object(source_files[index]);
+        };
+
+        Array<usize> eligible(get_global_allocator());
+        for (usize i = 0; i < source_files.count(); ++i) {
+            bool excluded = false;
+            for (auto& excluded_file : unity_excluded_files)
+                if (excluded_file == source_files[i]) excluded = true;
+            if (excluded) add_separate_object(i);
+            else eligible.push(i);
+        }
+        if (eligible.count() < 2) {
+            for (auto index : eligible) add_separate_object(index);
+            return true;
+        }
+
+        // Layout of previous unity build, every line is "<batch> <source file>"
+        StrBuilder layout_path(get_global_allocator());
+        layout_path.append(_output_folder);
+        layout_path.append("/unity.batches");
+        layout_path.append_null(false);
+        Array<s64> batch_of(get_global_allocator());
+        for (usize i = 0; i < source_files.count(); ++i) batch_of.push(-1);
+        Array<bool> batch_valid(get_global_allocator());
+        StrBuilder layout(get_global_allocator());
+        bool has_layout;
+        {
+            ScopedLogger _(logger_muted);
+            has_layout = read_entire_file(layout_path.to_string_view(true), layout);
+        }
+        if (has_layout) {
+            auto view = layout.to_string_view();
+            while (view.size > 0) {
+                auto line = view.chop_left_by_delimeter("\n");
+                line.trim_right_char('\n');
+                usize batch = 0;
+                while (line.size > 0 && line.first() >= '0' && line.first() <= '9') {
+                    batch = batch * 10 + (line.first() - '0');
+                    line.chop_left(1);
+                }
+                line.trim_left();
+                if (line.size == 0) continue;
+                while (batch_valid.count() <= batch) batch_valid.push(true);
+                bool found = false;
+                for (auto index : eligible) {
+                    if (source_files[index] == line) {
+                        batch_of[index] = (s64)batch;
+                        found = true;
+                    }
+                }
+                // Batch that includes removed or excluded file can't be linked anymore
+                if (!found) batch_valid[batch] = false;
+            }
+        }
+        for (usize batch = 0; batch < batch_valid.count(); ++batch) {
+            if (!batch_valid[batch]) continue;
+            const auto unity_source = get_unity_source_path(_output_folder, batch, is_cpp);
+            StrBuilder unity_object_path(get_global_allocator());
+            const auto unity_object = get_object_path(unity_object_path, unity_source, _output_folder);
+            bool valid = file_needs_rebuilt_cpp(unity_object, unity_source, _output_folder, _custom_compiler, stat_cache, &database) == Result::SL_FALSE;
+            if (valid) {
+                auto* record = database.find_record(unity_object);
+                valid = record && record->command_hash == command_hash;
+            }
+            batch_valid[batch] = valid;
+        }
+
+        bool full_rebuild = true;
+        for (auto index : eligible) {
+            const auto batch = batch_of[index];
+            if ((batch >= 0 && batch_valid[batch]) || !stale_sources[index]) full_rebuild = false;
+        }
+        if (!full_rebuild) {
+            // Files of out of date batches fall back to separate objects
+            StrBuilder new_layout(get_global_allocator());
+            for (auto index : eligible) {
+                const auto batch = batch_of[index];
+                if (batch >= 0 && batch_valid[batch]) {
+                    new_layout.appendf("%lld ", (long long)batch);
+                    new_layout.append(source_files[index]);
+                    new_layout.append('\n');
+                } else add_separate_object(index);
+            }
+            for (usize batch = 0; batch < batch_valid.count(); ++batch) {
+                if (!batch_valid[batch]) continue;
+                add_object(get_unity_source_path(_output_folder, batch, is_cpp));
+            }
+            if (has_layout && new_layout.to_string_view() != layout.to_string_view()) {
+                if (!write_file_if_changed(layout_path.to_string_view(true), new_layout.to_string_view())) return false;
+            }
+            return true;
+        }
+
+        // Everything has to be compiled, so sources are grouped into batches of similar total size,
+        //  largest files are placed first, every next one goes to the least loaded batch
+        usize batches_count = unity_batches > 0 ? unity_batches : get_system_info().number_of_processors;
+        if (batches_count < 1) batches_count = 1;
+        if (batches_count > eligible.count()) batches_count = eligible.count();
+        Array<usize> sizes(get_global_allocator());
+        for (usize i = 0; i < source_files.count(); ++i) {
+            u64 size = 0;
+            if (stat_cache) {
+                stat_cache->get_size(source_files[i], size);
+            } else {
+                FileTimeUnit time;
+                usize file_size = 0;
+                ScopedLogger _(logger_muted);
+                if (get_file_time_and_size(source_files[i], time, file_size)) size = file_size;
+            }
+            sizes.push((usize)size);
+        }
+        Array<usize> by_size(get_global_allocator());
+        for (auto index : eligible) {
+            usize position = by_size.count();
+            by_size.push(index);
+            while (position > 0 && sizes[by_size[position - 1]] < sizes[index]) {
+                by_size[position] = by_size[position - 1];
+                --position;
+            }
+            by_size[position] = index;
+        }
+        Array<usize> loads(get_global_allocator());
+        for (usize batch = 0; batch < batches_count; ++batch) loads.push(0);
+        for (auto index : by_size) {
+            usize least_loaded = 0;
+            for (usize batch = 1; batch < batches_count; ++batch)
+                if (loads[batch] < loads[least_loaded]) least_loaded = batch;
+            loads[least_loaded] += sizes[index] + 1;
+            batch_of[index] = (s64)least_loaded;
+        }
+
+        StrBuilder new_layout(get_global_allocator());
+        for (usize batch = 0; batch < batches_count; ++batch) {
+            // Sources keep their order inside of the batch
+            StrBuilder content(get_global_allocator());
+            content.append("// Unity build batch, generated by ezbuild\n");
+            for (auto index : eligible) {
+                if (batch_of[index] != (s64)batch) continue;
+                StrBuilder absolute_path(get_global_allocator());
+                if (!get_absolute_path(source_files[index], absolute_path)) return false;
+                content.append("#include \"");
+                content.append(absolute_path.to_string_view());
+                content.append("\"\n");
+                new_layout.appendf("%zu ", batch);
+                new_layout.append(source_files[index]);
+                new_layout.append('\n');
+            }
+            const auto unity_source = get_unity_source_path(_output_folder, batch, is_cpp);
+            if (!write_file_if_changed(unity_source, content.to_string_view())) return false;
+            if (stat_cache) stat_cache->invalidate(unity_source);
+            compile_files_out.push(unity_source);
+            add_object(unity_source);
+        }
+        if (!write_file_if_changed(layout_path.to_string_view(true), new_layout.to_string_view())) return false;
+        log_info("Unity build: %zu files in %zu batches\n", eligible.count(), batches_count);
+        return true;
+    }
+
+    // Executes current command and waits for it, process is recorded to trace (if it's set)
+    static bool execute_traced(Cmd& cmd, BuildTrace* trace, StrView category, StrView name, CmdOptions options = {})
+    {
+        const bool reset_command = options.reset_command;
+        options.reset_command = false;
+        options.wait_command = false;
+        auto proc = cmd.execute(options);
+        if (trace && proc.id != INVALID_PROCESS) trace->begin(category, name, StrView(cmd.data(), cmd.count()), proc.id);
+        if (reset_command) cmd.reset();
+        const bool success = proc.wait();
+        if (trace) trace->end(proc);
+        return success;
+    }
+
+    bool Cmd::build_precompiled_header(FlagsCompiler compiler, bool& rebuilt_out, BuildDatabase* database, FileStatCache* stat_cache, BuildTrace* trace)
+    {
+        rebuilt_out = false;
+        if (_precompiled_header.size < 1) return true;
+        const auto header = _precompiled_header;
+        build_tree_of_folders(header);
+
+        StrBuilder pch_path_buffer(get_global_allocator());
+        StrBuilder dependency_path_buffer(get_global_allocator());
+        const auto pch_path = get_precompiled_header_path(pch_path_buffer, header, compiler, _output_folder);
+        const auto dependency_path = get_dependency_path(dependency_path_buffer, header, compiler, _output_folder);
+        StrBuilder msvc_object(get_global_allocator());
+        if (compiler == FlagsCompiler::MSVC) {
+            // MSVC makes precompiled header from translation unit, and its object has to be linked too
+            msvc_object.append(pch_path);
+            msvc_object.append(".obj");
+            msvc_object.append_null(false);
+        }
+
+        const auto mark = this->_count;
+        const u64 command_hash = get_command_fingerprint();
+        bool needs_compile = database == nullptr || file_needs_rebuilt_cpp(pch_path, header, _output_folder, _custom_compiler, stat_cache, database) != Result::SL_FALSE;
+        if (!needs_compile) {
+            auto* record = database->find_record(pch_path);
+            needs_compile = !record || record->command_hash != command_hash;
+        }
+        if (needs_compile) {
+            log_info("Precompiling header: " SV_FORMAT "\n", SV_ARG(header));
+            if (compiler == FlagsCompiler::MSVC) {
+                StrBuilder source_path(get_global_allocator());
+                source_path.append(pch_path);
+                source_path.append(".cpp");
+                source_path.append_null(false);
+                {
+                    ScopedLogger _(logger_muted);
+                    FileHandle source;
+                    if (!create_file(source_path.to_string_view(true), source)) {
+                        log_error("Failed to create translation unit for precompiled header \"" SV_FORMAT "\"\n", SV_ARG(header));
+                        return false;
+                    }
+                    close_file(source);
+                }
+                append("/c /Yc");
+                append(header);
+                append(" /FI");
+                append(header);
+                append(" /Fp:");
+                append(pch_path);
+                append(" /sourceDependencies ");
+                append(dependency_path);
+                append(" /Fo:");
+                append(msvc_object.to_string_view(true));
+                append(' ');
+                append(source_path.to_string_view(true));
+            } else {
+                append(is_cpp ? "-x c++-header " : "-x c-header ");
+                append(header);
+                append(" -MMD -MF ");
+                append(dependency_path);
+                append(" -o ");
+                append(pch_path);
+            }
+            append_null(false);
+            CmdOptions options = {};
+            options.reset_command = false;
+            const bool success = execute_traced(*this, trace, "compile", header, options);
+            this->_count = mark;
+            if (!success) {
+                log_error("Failed to precompile header \"" SV_FORMAT "\"\n", SV_ARG(header));
+                return false;
+            }
+            rebuilt_out = true;
+            if (stat_cache) stat_cache->invalidate(pch_path);
+            if (database) {
+                ScopedLogger _(logger_muted);
+                FileTimeUnit pch_time;
+                Array<StrView> deps(get_global_allocator());
+                if (get_file_write_time(pch_path, pch_time, stat_cache) && read_unescaped_dependencies(header, deps, _output_folder, _custom_compiler))
+                    database->update_record(pch_path, header, deps, pch_time, command_hash);
+            }
+        }
+        return true;
+    }
+
+    void Cmd::append_precompiled_header_flags(FlagsCompiler compiler)
+    {
+        if (_precompiled_header.size < 1) return;
+        const auto header = _precompiled_header;
+        StrBuilder pch_path_buffer(get_global_allocator());
+        const auto pch_path = get_precompiled_header_path(pch_path_buffer, header, compiler, _output_folder);
+        // Every source is compiled as if the header was included at its top
+        if (compiler == FlagsCompiler::MSVC) {
+            append("/Yu");
+            append(header);
+            append(" /FI");
+            append(header);
+            append(" /Fp:");
+            append(pch_path);
+        } else if (compiler == FlagsCompiler::GCC) {
+            append("-Winvalid-pch -include ");
+            append(_output_folder);
+            append('/');
+            append(header);
+        } else {
+            append("-include-pch ");
+            append(pch_path);
+        }
+        append(' ');
+    }
+
+    void BuildTrace::begin(StrView category, StrView name, StrView command, ProcessID id)
+    {
+        Event event;
+        event.category = category;
+        event.name = StrView((const char*)memory_duplicate(*get_global_allocator(), name.data, name.size), name.size);
+        event.command = StrView((const char*)memory_duplicate(*get_global_allocator(), command.data, command.size), command.size);
+        event.id = id;
+        event.start = get_monotonic_time() - start_time;
+        while (event.lane < busy_lanes.count() && busy_lanes[event.lane]) ++event.lane;
+        if (event.lane == busy_lanes.count()) busy_lanes.push(true);
+        else busy_lanes[event.lane] = true;
+        events.push(event);
+    }
+
+    void BuildTrace::end(const Process& process)
+    {
+        for (auto& event : events) {
+            if (event.finished || event.id != process.id) continue;
+            event.end = get_monotonic_time() - start_time;
+            event.exit_code = process.exit_code;
+            event.finished = true;
+            busy_lanes[event.lane] = false;
+            return;
+        }
+    }
+
+    static void append_json_string(StrBuilder& builder, StrView str)
+    {
+        builder.append('"');
+        for (usize i = 0; i < str.size; ++i) {
+            const char c = str.data[i];
+            if (c == '"' || c == '\\') {
+                builder.append('\\');
+                builder.append(c);
+            } else if ((unsigned char)c < 0x20) {
+                builder.appendf("\\u%04x", (unsigned)c);
+            } else builder.append(c);
+        }
+        builder.append('"');
+    }
+
+    bool BuildTrace::write(StrView file)
+    {
+        const u64 now = get_monotonic_time() - start_time;
+        StrBuilder json(get_global_allocator());
+        json.append("{\"traceEvents\":[\n");
+        for (usize lane = 0; lane < busy_lanes.count(); ++lane) {
+            json.appendf("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":\"Slot %zu\"}},\n", lane + 1, lane + 1);
+        }
+        for (usize i = 0; i < events.count(); ++i) {
+            auto& event = events[i];
+            // Processes, which were never waited on (build was interrupted), last till the end of trace
+            const u64 end = event.finished ? event.end : now;
+            json.append("{\"name\":");
+            append_json_string(json, event.name);
+            json.append(",\"cat\":");
+            append_json_string(json, event.category);
+            json.appendf(",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":1,\"tid\":%u,\"args\":{\"command\":",
+                         (unsigned long long)event.start, (unsigned long long)(end - event.start), event.lane + 1);
+            append_json_string(json, event.command);
+            json.appendf(",\"exit_code\":%d}}%s\n", event.exit_code, i + 1 < events.count() ? "," : "");
+        }
+        json.append("]}\n");
+        if (!write_to_file(file, json.data(), json.count())) {
+            log_error("Failed to write build trace to \"" SV_FORMAT "\"\n", SV_ARG(file));
+            return false;
+        }
+        log_info("Build trace is written to \"" SV_FORMAT "\"\n", SV_ARG(file));
+        return true;
+    }
+
+    void BuildTrace::cleanup()
+    {
+        events.cleanup();
+        busy_lanes.cleanup();
+    }
+
+    // Minimal JSON reading, which is enough for trace files
+    static void json_skip_whitespace(StrView& json)
+    {
+        while (json.size > 0 && (json.first() == ' ' || json.first() == '\n' || json.first() == '\r' || json.first() == '\t'))
+            json.chop_left(1);
+    }
+    // Unescaped string is appended to provided builder, if it's not null
+    static bool json_read_string(StrView& json, StrBuilder* string_out)
+    {
+        json_skip_whitespace(json);
+        if (json.size == 0 || json.first() != '"') return false;
+        json.chop_left(1);
+        while (json.size > 0) {
+            char c = json.first();
+            json.chop_left(1);
+            if (c == '"') return true;
+            if (c == '\\' && json.size > 0) {
+                c = json.first();
+                json.chop_left(1);
+                if (c == 'n') c = '\n';
+                else if (c == 't') c = '\t';
+                else if (c == 'r') c = '\r';
+                else if (c == 'b') c = '\b';
+                else if (c == 'f') c = '\f';
+                else if (c == 'u') {
+                    // Only ASCII is decoded, other characters are replaced
+                    u32 code = 0;
+                    for (int i = 0; i < 4 && json.size > 0; ++i) {
+                        const char digit = json.first();
+                        json.chop_left(1);
+                        code <<= 4;
+                        if (digit >= '0' && digit <= '9') code |= digit - '0';
+                        else if (digit >= 'a' && digit <= 'f') code |= digit - 'a' + 10;
+                        else if (digit >= 'A' && digit <= 'F') code |= digit - 'A' + 10;
+                    }
+                    c = code < 0x80 ? (char)code : '?';
+                }
+            }
+            if (string_out) string_out->append(c);
+        }
+        return false;
+    }
+    static bool json_skip_value(StrView& json)
+    {
+        json_skip_whitespace(json);
+        if (json.size == 0) return false;
+        if (json.first() == '"') return json_read_string(json, nullptr);
+        if (json.first() == '{' || json.first() == '[') {
+            usize depth = 0;
+            while (json.size > 0) {
+                const char c = json.first();
+                if (c == '"') {
+                    if (!json_read_string(json, nullptr)) return false;
+                    continue;
+                }
+                json.chop_left(1);
+                if (c == '{' || c == '[') ++depth;
+                else if ((c == '}' || c == ']') && --depth == 0) return true;
+            }
+            return false;
+        }
+        // Number, true, false or null
+        while (json.size > 0 && json.first() != ',' && json.first() != '}' && json.first() != ']'
+               && json.first() != ' ' && json.first() != '\n' && json.first() != '\r' && json.first() != '\t')
+            json.chop_left(1);
+        return true;
+    }
+    static bool json_read_number(StrView& json, u64& number_out)
+    {
+        json_skip_whitespace(json);
+        number_out = 0;
+        if (json.size == 0 || json.first() < '0' || json.first() > '9') {
+            json_skip_value(json);
+            return false;
+        }
+        while (json.size > 0 && json.first() >= '0' && json.first() <= '9') {
+            number_out = number_out * 10 + (json.first() - '0');
+            json.chop_left(1);
+        }
+        return json_skip_value(json); // Fraction part
+    }
+    // Calls callback(key) for every key of object, callback has to read or skip the value
+    template<typename Callback>
+    static bool json_read_object(StrView& json, Callback&& callback)
+    {
+        json_skip_whitespace(json);
+        if (json.size == 0 || json.first() != '{') return false;
+        json.chop_left(1);
+        while (true) {
+            json_skip_whitespace(json);
+            if (json.size == 0) return false;
+            if (json.first() == '}') {
+                json.chop_left(1);
+                return true;
+            }
+            if (json.first() == ',') {
+                json.chop_left(1);
+                continue;
+            }
+            StrBuilder key(get_global_allocator());
+            if (!json_read_string(json, &key)) return false;
+            json_skip_whitespace(json);
+            if (json.size == 0 || json.first() != ':') return false;
+            json.chop_left(1);
+            if (!callback(key.to_string_view())) return false;
+        }
+    }
+
+    struct TimeTraceEntry
+    {
+        StrView name;
+        u64 total; // Microseconds
+        u32 count;
+    };
+
+    static void add_time_trace_entry(Array<TimeTraceEntry>& entries, HashMap<StrView, usize, StrView::hash>& indices, StrView name, u64 duration)
+    {
+        if (auto* index = indices.get(name)) {
+            entries[*index].total += duration;
+            ++entries[*index].count;
+            return;
+        }
+        StrView copy((const char*)memory_duplicate(*get_global_allocator(), name.data, name.size), name.size);
+        entries.push(TimeTraceEntry{copy, duration, 1});
+        indices.insert(copy, entries.count() - 1);
+    }
+
+    static void print_time_trace_entries(const char* title, Array<TimeTraceEntry>& entries, usize top_count, bool show_count)
+    {
+        log_info("%s\n", title);
+        // Only few of the largest are needed, so they are selected one by one instead of sorting everything
+        Array<bool> is_printed(get_global_allocator());
+        for (usize i = 0; i < entries.count(); ++i) is_printed.push(false);
+        for (usize printed = 0; printed < top_count && printed < entries.count(); ++printed) {
+            usize largest = entries.count();
+            for (usize i = 0; i < entries.count(); ++i) {
+                if (is_printed[i]) continue;
+                if (largest == entries.count() || entries[i].total > entries[largest].total) largest = i;
+            }
+            is_printed[largest] = true;
+            auto& entry = entries[largest];
+            if (show_count)
+                log_info("  %9.1f ms  %6u times (avg %.1f ms)  " SV_FORMAT "\n", (double)entry.total / 1000.0, entry.count,
+                         (double)entry.total / 1000.0 / entry.count, SV_ARG(entry.name));
+            else
+                log_info("  %9.1f ms  " SV_FORMAT "\n", (double)entry.total / 1000.0, SV_ARG(entry.name));
+        }
+    }
+
+    bool report_time_trace(Array<StrView>& trace_files, usize top_count)
+    {
+        Array<TimeTraceEntry> units(get_global_allocator());
+        Array<TimeTraceEntry> includes(get_global_allocator());
+        Array<TimeTraceEntry> templates(get_global_allocator());
+        HashMap<StrView, usize, StrView::hash> unit_indices = {};
+        HashMap<StrView, usize, StrView::hash> include_indices = {};
+        HashMap<StrView, usize, StrView::hash> template_indices = {};
+        usize read_files = 0;
+        for (auto& trace_file : trace_files) {
+            StrBuilder content(get_global_allocator());
+            {
+                ScopedLogger _(logger_muted);
+                if (!read_entire_file(trace_file, content)) continue; // Object restored from cache has no trace
+            }
+            auto unit_name = trace_file;
+            if (unit_name.ends_with(".json")) unit_name.chop_right(5);
+            u64 unit_time = 0;
+            auto read_event = [&](StrView& json) -> bool {
+                StrBuilder name(get_global_allocator());
+                StrBuilder detail(get_global_allocator());
+                u64 duration = 0;
+                bool ok = json_read_object(json, [&](StrView key) -> bool {
+                    if (key == "name") return json_read_string(json, &name);
+                    if (key == "dur") return json_read_number(json, duration);
+                    if (key == "args") {
+                        return json_read_object(json, [&](StrView arg) -> bool {
+                            if (arg == "detail") return json_read_string(json, &detail);
+                            return json_skip_value(json);
+                        });
+                    }
+                    return json_skip_value(json);
+                });
+                if (!ok) return false;
+                const auto event_name = name.to_string_view();
+                if (event_name == "ExecuteCompiler") {
+                    if (duration > unit_time) unit_time = duration;
+                } else if (event_name == "Source") {
+                    add_time_trace_entry(includes, include_indices, detail.to_string_view(), duration);
+                } else if (event_name == "InstantiateClass" || event_name == "InstantiateFunction") {
+                    add_time_trace_entry(templates, template_indices, detail.to_string_view(), duration);
+                }
+                return true;
+            };
+            auto json = content.to_string_view();
+            const bool parsed = json_read_object(json, [&](StrView key) -> bool {
+                if (key != "traceEvents") return json_skip_value(json);
+                json_skip_whitespace(json);
+                if (json.size == 0 || json.first() != '[') return false;
+                json.chop_left(1);
+                while (true) {
+                    json_skip_whitespace(json);
+                    if (json.size == 0) return false;
+                    if (json.first() == ']') {
+                        json.chop_left(1);
+                        return true;
+                    }
+                    if (json.first() == ',') {
+                        json.chop_left(1);
+                        continue;
+                    }
+                    if (!read_event(json)) return false;
+                }
+            });
+            if (!parsed) {
+                log_warning("Could not parse time trace \"" SV_FORMAT "\"\n", SV_ARG(trace_file));
+                continue;
+            }
+            add_time_trace_entry(units, unit_indices, unit_name, unit_time);
+            ++read_files;
+        }
+        unit_indices.cleanup();
+        include_indices.cleanup();
+        template_indices.cleanup();
+        if (read_files == 0) {
+            log_warning("There are no time traces to report\n");
+            return false;
+        }
+        log_info("Time trace of %zu files:\n", read_files);
+        print_time_trace_entries("Slowest files:", units, top_count, false);
+        print_time_trace_entries("Most expensive includes (total time of all inclusions):", includes, top_count, true);
+        print_time_trace_entries("Most expensive template instantiations:", templates, top_count, true);
+        return true;
+    }
+
+    // Remote compile protocol: every connection carries one request, integers are sent as 8 bytes in big endian.
+    //  Request:  "EZBW", version, secret, type, then for compile: compiler name, language, number of options,
+    //            options, preprocessed file
+    //  Response: for info: slots, running compiles; for compile: exit code, compiler output, object file
+    //  (strings and files are sent as size followed by data). Worker builds compile command by itself,
+    //  only from compilers and options, that it knows (see is_remote_option_allowed())
+    enum class RemoteRequest : u64
+    {
+        INFO = 1,
+        COMPILE = 2,
+    };
+    static const u64 REMOTE_PROTOCOL_VERSION = 2;
+    static const u64 REMOTE_MAX_DATA_SIZE = 256ull << 20; // Preprocessed file or object
+    static const u64 REMOTE_MAX_OPTIONS = 256;
+
+#if !defined(_WIN32)
+    static bool socket_write(int socket, const void* data, usize size)
+    {
+        const char* cursor = (const char*)data;
+        while (size > 0) {
+            const ssize_t written = write(socket, cursor, size);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) return false;
+            cursor += written;
+            size -= (usize)written;
+        }
+        return true;
+    }
+
+    static bool socket_read(int socket, void* data, usize size)
+    {
+        char* cursor = (char*)data;
+        while (size > 0) {
+            const ssize_t received = read(socket, cursor, size);
+            if (received < 0 && errno == EINTR) continue;
+            if (received <= 0) return false;
+            cursor += received;
+            size -= (usize)received;
+        }
+        return true;
+    }
+
+    static bool socket_write_u64(int socket, u64 value)
+    {
+        unsigned char bytes[8];
+        for (int i = 0; i < 8; ++i)
+            bytes[i] = (unsigned char)(value >> (56 - i * 8));
+        return socket_write(socket, bytes, sizeof(bytes));
+    }
+
+    static bool socket_read_u64(int socket, u64& value_out)
+    {
+        unsigned char bytes[8];
+        if (!socket_read(socket, bytes, sizeof(bytes))) return false;
+        value_out = 0;
+        for (int i = 0; i < 8; ++i)
+            value_out = (value_out << 8) | bytes[i];
+        return true;
+    }
+
+    static bool socket_write_data(int socket, const char* data, usize size)
+    {
+        return socket_write_u64(socket, size) && socket_write(socket, data, size);
+    }
+
+    // Data is allocated by global allocator, max_size protects from garbage sizes
+    static bool socket_read_data(int socket, StrBuilder& data_out, u64 max_size = REMOTE_MAX_DATA_SIZE)
+    {
+        u64 size;
+        if (!socket_read_u64(socket, size) || size > max_size) return false;
+        data_out.reserve(data_out.count() + size + 1);
+        if (!socket_read(socket, data_out.data() + data_out.count(), size)) return false;
+        data_out.set_count(data_out.count() + size);
+        return true;
+    }
+
+    // Address without host ("":port) is loopback, all interfaces have to be asked for explicitly (0.0.0.0:port or [::]:port)
+    static bool parse_socket_address(StrView address, sockaddr_storage& address_out, socklen_t& size_out)
+    {
+        memory_zero(&address_out, sizeof(address_out));
+        if (address.starts_with("unix:")) {
+            auto path = address;
+            path.chop_left(5);
+            auto* unix_address = (sockaddr_un*)&address_out;
+            if (path.size == 0 || path.size >= sizeof(unix_address->sun_path)) {
+                log_error("Invalid unix socket path \"" SV_FORMAT "\"\n", SV_ARG(address));
+                return false;
+            }
+            unix_address->sun_family = AF_UNIX;
+            memory_copy(unix_address->sun_path, sizeof(unix_address->sun_path), path.data, path.size);
+            size_out = sizeof(sockaddr_un);
+            return true;
+        }
+        const auto colon_index = address.find_last(':');
+        if (colon_index == StrView::INVALID_INDEX) {
+            log_error("Address \"" SV_FORMAT "\" has to be \"unix:path\" or \"host:port\"\n", SV_ARG(address));
+            return false;
+        }
+        StrView host_view(address.data, colon_index);
+        if (host_view.size >= 2 && host_view.first() == '[' && host_view.last() == ']') {
+            host_view.chop_left(1);
+            host_view.chop_right(1);
+        }
+        StrBuilder host(get_global_allocator());
+        StrBuilder port(get_global_allocator());
+        host.append(host_view);
+        host.append_null(false);
+        port.append(address.data + colon_index + 1, address.size - colon_index - 1);
+        port.append_null(false);
+        addrinfo hints;
+        memory_zero(&hints, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* result = nullptr;
+        const int error = getaddrinfo(host.count() > 0 ? host.data() : nullptr, port.data(), &hints, &result);
+        if (error != 0 || !result) {
+            log_error("Could not resolve \"" SV_FORMAT "\": %s\n", SV_ARG(address), gai_strerror(error));
+            return false;
+        }
+        memory_copy(&address_out, sizeof(address_out), result->ai_addr, result->ai_addrlen);
+        size_out = result->ai_addrlen;
+        freeaddrinfo(result);
+        return true;
+    }
+
+    static int connect_to_worker(StrView address)
+    {
+        sockaddr_storage socket_address;
+        socklen_t socket_address_size;
+        if (!parse_socket_address(address, socket_address, socket_address_size)) return -1;
+        const int connection = socket(socket_address.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (connection < 0) {
+            report_error("Could not create socket");
+            return -1;
+        }
+        if (connect(connection, (sockaddr*)&socket_address, socket_address_size) != 0) {
+            report_error("Could not connect to remote worker \"" SV_FORMAT "\"", SV_ARG(address));
+            close(connection);
+            return -1;
+        }
+        return connection;
+    }
+
+    static bool send_remote_request_header(int connection, StrView secret, RemoteRequest type)
+    {
+        return socket_write(connection, "EZBW", 4) && socket_write_u64(connection, REMOTE_PROTOCOL_VERSION)
+            && socket_write_data(connection, secret.data, secret.size) && socket_write_u64(connection, (u64)type);
+    }
+
+    // Every byte is compared, so time of comparison doesn't tell how much of the secret was right
+    static bool is_remote_secret_valid(StrView received, StrView secret)
+    {
+        if (secret.size == 0) return false;
+        u8 difference = received.size == secret.size ? 0 : 1;
+        for (usize i = 0; i < received.size; ++i)
+            difference |= (u8)received.data[i] ^ (u8)secret.data[i % secret.size];
+        return difference == 0;
+    }
+
+    // Worker runs only compilers, not arbitrary programs sent to it. Name is looked up in PATH of the worker
+    static bool is_remote_compiler_allowed(StrView compiler)
+    {
+        // Version suffix is allowed, like g++-13 or clang-18
+        const auto dash_index = compiler.find_last('-');
+        if (dash_index != StrView::INVALID_INDEX && dash_index + 1 < compiler.size) {
+            bool is_version = true;
+            for (usize i = dash_index + 1; i < compiler.size; ++i)
+                is_version &= (compiler.data[i] >= '0' && compiler.data[i] <= '9') || compiler.data[i] == '.';
+            if (is_version) compiler.chop_right(compiler.size - dash_index);
+        }
+        const StrView compilers[] = {"cc", "c++", "gcc", "g++", "clang", "clang++"};
+        for (auto& known : compilers) {
+            if (compiler == known) return true;
+        }
+        return false;
+    }
+
+    // Options, that only change generated code or diagnostics. None of them can name a file or a program
+    //  (-fplugin=, -B, -wrapper, -specs=, @file, -Wl,...), since only letters, digits and "_.+-=" are allowed.
+    //  -f switches are only the known ones, many others write files on worker (-fdump-*, -fprofile-*, -fstack-usage)
+    static bool is_remote_option_allowed(StrView option)
+    {
+        if (option.size < 2 || option.first() != '-') return false;
+        bool has_value = false;
+        for (usize i = 1; i < option.size; ++i) {
+            const char ch = option.data[i];
+            const bool is_alnum = (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9');
+            if (!is_alnum && ch != '_' && ch != '.' && ch != '+' && ch != '-' && ch != '=') return false;
+            has_value |= ch == '=';
+        }
+        const StrView exact[] = {"-w", "-pedantic", "-pedantic-errors", "-ansi", "-pthread", "-m32", "-m64"};
+        for (auto& allowed : exact) {
+            if (option == allowed) return true;
+        }
+        const StrView prefixes[] = {"-O", "-g", "-W", "-std=", "-march=", "-mtune=", "-mcpu=",
+                                    "-fvisibility=", "-fsanitize=", "-fno-sanitize=", "-flto=", "-ffp-contract="};
+        for (auto& prefix : prefixes) {
+            if (option.starts_with(prefix)) return true;
+        }
+        // Switches like -fPIC, -fno-exceptions or -mavx2, options with values are only the ones above
+        if (has_value) return false;
+        if (option.starts_with("-m")) return option != "-mllvm";
+        if (!option.starts_with("-f")) return false;
+        option.chop_left(2);
+        if (option.starts_with("no-")) option.chop_left(3);
+        const StrView code_switches[] = {
+            "PIC", "pic", "PIE", "pie", "plt", "semantic-interposition", "common", "exceptions", "rtti",
+            "asynchronous-unwind-tables", "unwind-tables", "threadsafe-statics", "strict-aliasing", "strict-overflow",
+            "wrapv", "trapv", "signed-char", "unsigned-char", "short-enums", "builtin", "delete-null-pointer-checks",
+            "omit-frame-pointer", "inline", "inline-functions", "unroll-loops", "vectorize", "tree-vectorize",
+            "slp-vectorize", "fast-math", "finite-math-only", "math-errno", "function-sections", "data-sections",
+            "stack-protector", "stack-protector-strong", "stack-protector-all", "stack-clash-protection",
+            "cf-protection", "sanitize-recover", "visibility-inlines-hidden", "lto", "openmp", "permissive",
+            "char8_t", "coroutines", "diagnostics-color", "color-diagnostics",
+        };
+        for (auto& allowed : code_switches) {
+            if (option == allowed) return true;
+        }
+        return false;
+    }
+
+    // Compiles file received over connection in its own temporary folder and sends back result
+    static bool serve_remote_compile(int connection)
+    {
+        StrBuilder compiler(get_global_allocator());
+        StrBuilder language(get_global_allocator());
+        Array<StrView> options(get_global_allocator());
+        StrBuilder source(get_global_allocator());
+        u64 options_count = 0;
+        bool is_received = socket_read_data(connection, compiler, 64) && socket_read_data(connection, language, 8)
+            && socket_read_u64(connection, options_count) && options_count <= REMOTE_MAX_OPTIONS;
+        bool is_allowed = is_received && is_remote_compiler_allowed(compiler.to_string_view())
+            && (language.to_string_view() == "c" || language.to_string_view() == "c++");
+        for (u64 i = 0; i < options_count && is_received; ++i) {
+            StrBuilder option(get_global_allocator());
+            is_received = socket_read_data(connection, option, 256);
+            if (!is_received) break;
+            if (!is_remote_option_allowed(option.to_string_view())) {
+                log_error("Compile option \"" SV_FORMAT "\" was rejected\n", SV_ARG(option.to_string_view()));
+                is_allowed = false;
+            }
+            options.push(option.to_string_view());
+        }
+        // Nothing is compiled (and no memory is taken for the file) if request isn't allowed
+        if (!is_received || !is_allowed) {
+            log_error("Compile request was rejected\n");
+            return false;
+        }
+        if (!socket_read_data(connection, source)) {
+            log_error("Could not receive compile request\n");
+            return false;
+        }
+
+        const char* temporary_env = getenv("TMPDIR");
+        StrBuilder folder(get_global_allocator());
+        folder.append(temporary_env && temporary_env[0] ? temporary_env : "/tmp");
+        folder.append("/ezbuild_worker_XXXXXX");
+        folder.append_null(false);
+        if (!mkdtemp(folder.data())) {
+            report_error("Could not create temporary folder");
+            return false;
+        }
+        StrBuilder source_path(get_global_allocator());
+        StrBuilder object_path(get_global_allocator());
+        StrBuilder output_path(get_global_allocator());
+        // Compiler knows from extension, that file is preprocessed
+        source_path.appendf("%s/source%s", folder.data(), language.to_string_view() == "c" ? ".i" : ".ii");
+        source_path.append_null(false);
+        object_path.appendf("%s/object.o", folder.data());
+        object_path.append_null(false);
+        output_path.appendf("%s/output.txt", folder.data());
+        output_path.append_null(false);
+
+        s64 exit_code = -1;
+        StrBuilder output(get_global_allocator());
+        StrBuilder object(get_global_allocator());
+        FileHandle output_file;
+        if (write_to_file(source_path.to_string_view(true), source.data(), source.count())
+            && create_file(output_path.to_string_view(true), output_file)) {
+            Cmd cmd = {};
+            cmd.push(compiler.to_string_view());
+            for (auto& option : options) cmd.push(option);
+            cmd.appendf("-c %s -o %s", source_path.data(), object_path.data());
+            CmdOptions cmd_options = {};
+            cmd_options.print_command = false;
+            cmd_options.stdout_desc = &output_file;
+            cmd_options.stderr_desc = &output_file;
+            exit_code = cmd.execute(cmd_options).exit_code;
+            close_file(output_file);
+            ScopedLogger _(logger_muted);
+            read_entire_file(output_path.to_string_view(true), output);
+            if (exit_code == 0 && !read_entire_file(object_path.to_string_view(true), object))
+                exit_code = -1;
+        }
+        delete_file(source_path.to_string_view(true));
+        delete_file(object_path.to_string_view(true));
+        delete_file(output_path.to_string_view(true));
+        rmdir(folder.data());
+        return socket_write_u64(connection, (u64)exit_code) && socket_write_data(connection, output.data(), output.count())
+            && socket_write_data(connection, object.data(), object.count());
+    }
+
+    // Options of the compile command, which worker has to know. Preprocessor options (they are already applied)
+    //  are left out, false is returned if some other option isn't allowed by worker, then file is compiled locally
+    static bool get_remote_compile_options(StrView flags, StrView& compiler_out, Array<StrView>& options_out)
+    {
+        flags.trim();
+        auto compiler = flags.chop_left_by_delimeter(" ");
+        compiler.trim_right_char(' ');
+        const auto slash_index = compiler.find_last('/');
+        if (slash_index != StrView::INVALID_INDEX) compiler.chop_left(slash_index + 1);
+        if (!is_remote_compiler_allowed(compiler)) return false;
+        compiler_out = compiler;
+        const StrView with_argument[] = {"-I", "-D", "-U", "-include", "-imacros", "-isystem", "-iquote", "-idirafter", "-MF", "-MT", "-MQ"};
+        const StrView preprocessor[] = {"-I", "-D", "-U", "-include", "-imacros", "-isystem", "-iquote", "-idirafter", "-M", "-nostdinc"};
+        bool skip_next = false;
+        while (flags.size > 0) {
+            auto option = flags.chop_left_by_delimeter(" ");
+            option.trim_right_char(' ');
+            if (option.size == 0) continue;
+            if (skip_next) {
+                skip_next = false;
+                continue;
+            }
+            bool is_preprocessor = false;
+            for (auto& prefix : preprocessor) is_preprocessor |= option.starts_with(prefix);
+            for (auto& separate : with_argument) skip_next |= option == separate;
+            if (is_preprocessor) continue;
+            if (!is_remote_option_allowed(option)) return false;
+            options_out.push(option);
+        }
+        return true;
+    }
+
+    // Runs in child process of the build: sends preprocessed file and writes received object.
+    //  Exit code is exit code of remote compiler, or -1 (255) if worker couldn't be reached or compile options aren't allowed
+    static int run_remote_compile(StrView address, StrView secret, StrView flags, bool is_cpp, StrView preprocessed_path, StrView object_path)
+    {
+        StrView compiler("");
+        Array<StrView> options(get_global_allocator());
+        if (!get_remote_compile_options(flags, compiler, options)) return -1;
+        StrBuilder source(get_global_allocator());
+        if (!read_entire_file(preprocessed_path, source)) return -1;
+        const int connection = connect_to_worker(address);
+        if (connection < 0) return -1;
+        const StrView language = is_cpp ? "c++" : "c";
+        bool success = send_remote_request_header(connection, secret, RemoteRequest::COMPILE)
+            && socket_write_data(connection, compiler.data, compiler.size) && socket_write_data(connection, language.data, language.size)
+            && socket_write_u64(connection, options.count());
+        for (auto& option : options)
+            success = success && socket_write_data(connection, option.data, option.size);
+        u64 exit_code = (u64)-1;
+        StrBuilder output(get_global_allocator());
+        StrBuilder object(get_global_allocator());
+        success = success && socket_write_data(connection, source.data(), source.count())
+            && socket_read_u64(connection, exit_code) && socket_read_data(connection, output, 16 << 20) && socket_read_data(connection, object);
+        close(connection);
+        if (!success) {
+            log_error("Remote worker \"" SV_FORMAT "\" did not finish compile of " SV_FORMAT "\n", SV_ARG(address), SV_ARG(preprocessed_path));
+            return -1;
+        }
+        if (output.count() > 0) fwrite(output.data(), 1, output.count(), stderr);
+        if ((s64)exit_code == 0 && !write_to_file(object_path, object.data(), object.count())) return -1;
+        return (int)(s64)exit_code;
+    }
+#endif // !_WIN32
+
+    static u32 query_remote_worker(StrView address, StrView secret, u32* running_out)
+    {
+    #if defined(_WIN32)
+        UNUSED(address);
+        UNUSED(secret);
+        UNUSED(running_out);
+        log_warning("Remote workers are supported only on POSIX systems\n");
+        return 0;
+    #else
+        const int connection = connect_to_worker(address);
+        if (connection < 0) return 0;
+        u64 slots = 0;
+        u64 running = 0;
+        if (!send_remote_request_header(connection, secret, RemoteRequest::INFO) || !socket_read_u64(connection, slots) || !socket_read_u64(connection, running)) {
+            log_warning("Remote worker \"" SV_FORMAT "\" did not respond (is the secret right?)\n", SV_ARG(address));
+            slots = 0;
+        }
+        close(connection);
+        if (running_out) *running_out = (u32)running;
+        return (u32)slots;
+    #endif // !_WIN32
+    }
+
+    bool run_compile_worker(StrView address, StrView secret, usize max_jobs)
+    {
+    #if defined(_WIN32)
+        UNUSED(address);
+        UNUSED(secret);
+        UNUSED(max_jobs);
+        log_error("Compile worker is supported only on POSIX systems\n");
+        return false;
+    #else
+        if (secret.size == 0) {
+            log_error("Compile worker needs a secret, which clients have to know\n");
+            return false;
+        }
+        if (max_jobs == 0) max_jobs = get_system_info().number_of_processors;
+        sockaddr_storage socket_address;
+        socklen_t socket_address_size;
+        if (!parse_socket_address(address, socket_address, socket_address_size)) return false;
+        // Client, which disconnected early, must not kill the worker
+        signal(SIGPIPE, SIG_IGN);
+        const int listener = socket(socket_address.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listener < 0) {
+            report_error("Could not create socket");
+            return false;
+        }
+        if (socket_address.ss_family == AF_UNIX) {
+            unlink(((sockaddr_un*)&socket_address)->sun_path);
+        } else {
+            const int reuse = 1;
+            setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        }
+        if (bind(listener, (sockaddr*)&socket_address, socket_address_size) != 0 || listen(listener, 64) != 0) {
+            report_error("Could not listen on \"" SV_FORMAT "\"", SV_ARG(address));
+            close(listener);
+            return false;
+        }
+        log_info("Compile worker is listening on \"" SV_FORMAT "\" (%zu jobs)\n", SV_ARG(address), max_jobs);
+        usize running = 0;
+        for (;;) {
+            const int connection = accept(listener, nullptr, nullptr);
+            if (connection < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                report_error("Could not accept connection");
+                close(listener);
+                return false;
+            }
+            while (running > 0 && waitpid(-1, nullptr, WNOHANG) > 0)
+                --running;
+            // Client, which doesn't send anything, can't hold the worker
+            timeval timeout = {10, 0};
+            setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            char magic[4];
+            u64 version = 0;
+            u64 type = 0;
+            StrBuilder received_secret(get_global_allocator());
+            if (!socket_read(connection, magic, 4) || memcmp(magic, "EZBW", 4) != 0 || !socket_read_u64(connection, version)
+                || version != REMOTE_PROTOCOL_VERSION || !socket_read_data(connection, received_secret, 1024)) {
+                log_warning("Worker received invalid request\n");
+                close(connection);
+                continue;
+            }
+            // Nothing else is read from client, that doesn't know the secret
+            if (!is_remote_secret_valid(received_secret.to_string_view(), secret)) {
+                log_warning("Worker received request with wrong secret\n");
+                close(connection);
+                continue;
+            }
+            if (!socket_read_u64(connection, type)) {
+                close(connection);
+                continue;
+            }
+            if (type == (u64)RemoteRequest::INFO) {
+                socket_write_u64(connection, max_jobs);
+                socket_write_u64(connection, running);
+                close(connection);
+                continue;
+            }
+            if (type != (u64)RemoteRequest::COMPILE) {
+                close(connection);
+                continue;
+            }
+            // Requests over the limit wait here, so clients see the worker as busy
+            while (running >= max_jobs && waitpid(-1, nullptr, 0) > 0)
+                --running;
+            const pid_t child = fork();
+            if (child == 0) {
+                close(listener);
+                _exit(serve_remote_compile(connection) ? EXIT_SUCCESS : EXIT_FAILURE);
+            }
+            if (child > 0) ++running;
+            else report_error("Could not fork worker process");
+            close(connection);
+        }
+    #endif // !_WIN32
+    }
+
+    bool Cmd::prepare_build(BuildState& state, bool force_rebuilt)
+    {
+        const auto compiler = get_effective_compiler();
+        ASSERT_TRUE(source_files.count() == source_files_output.count());
+        create_folder(this->_output_folder);
+        append_custom_flags();
+        append_defines();
+        // Missing or outdated executable only needs linking, objects are checked separately
+        StrBuilder output_full_name(get_global_allocator());
+        output_full_name.append(output_name.data, output_name.size);
+        if (!output_contains_ext)
+            output_full_name.append(get_output_extension(executable_type));
+        output_full_name.append_null(false);
+        state.output_path = output_full_name.to_string_view(true);
+
+        const usize max_procs = max_concurrent_processes == 0 ? get_system_info().number_of_processors * 2 + 1 : max_concurrent_processes;
+        StrBuilder output_file_object(get_global_allocator());
+        StrBuilder dependency_file_path(get_global_allocator());
+
+        for (auto& file : source_files)
+            build_tree_of_folders(file);
+
+        state.database.load(_output_folder);
+        state.database.use_content_hash = content_hash;
+        state.database.stat_cache = &state.stat_cache;
+
+        // Precompiled header has to be ready before any source is compiled with it
+        bool pch_rebuilt;
+        if (!build_precompiled_header(compiler, pch_rebuilt, &state.database, &state.stat_cache, state.trace))
+            return false;
+
+        const auto mark = this->_count;
+        state.mark = mark;
+        // Compiler, push_flag_* flags, include paths, custom flags and defines are all in the command at this point
+        state.command_hash = get_command_fingerprint();
+        // Objects compiled without time trace are compiled again, so every object has its trace
+        if (time_trace) state.command_hash = hasher_fn_default(state.command_hash, "-ftime-trace", 12);
+        // Flags, that use precompiled header, are added only to compile commands (see get_compile_command())
+        if (_precompiled_header.size > 0)
+            state.command_hash = hasher_fn_default(state.command_hash, _precompiled_header.data, _precompiled_header.size);
+
+        const bool use_object_cache = _object_cache_folder.size > 0;
+        u64 compiler_identity = 0;
+        state.saved_cache_hits = cache_hits;
+        state.saved_cache_misses = cache_misses;
+        if (use_object_cache) {
+            {
+                ScopedLogger _(logger_muted);
+                create_folder(_object_cache_folder);
+            }
+            StrView compiler_name(_data, _count);
+            compiler_name.trim_left();
+            const auto space_index = compiler_name.find_first(' ');
+            if (space_index != StrView::INVALID_INDEX) compiler_name.chop_right(compiler_name.size - space_index);
+            compiler_identity = get_compiler_identity(compiler_name, compiler, _object_cache_folder);
+        }
+        if (!single_pass_dependencies) { // Generate dependency files of all changed sources in parallel, before making rebuild decisions
+            Processes scan_procs = {};
+            scan_procs.job_server = get_job_server(max_procs);
+            Array<SourceJob> scan_jobs(get_global_allocator());
+            auto wait_scan = [&]() -> bool {
+                Process finished;
+                bool success;
+                {
+                    ScopedLogger _(logger_muted);
+                    success = scan_procs.wait_any(&finished);
+                }
+                if (state.trace) state.trace->end(finished);
+                const auto index = take_source_job(scan_jobs, finished.id);
+                if (!success && index != SourceJob::INVALID_INDEX) {
+                    log_error("Failed to get dependencies of \"" SV_FORMAT "\"\n", SV_ARG(source_files[index]));
+                    ScopedLogger _(logger_muted);
+                    delete_file(get_dependency_path(output_file_object, source_files[index], compiler, _output_folder));
+                }
+                return success;
+            };
+            for (usize i = 0; i < source_files.count(); ++i) {
+                auto& file = source_files[i];
+                const auto dependency_path = get_dependency_path(output_file_object, file, compiler, _output_folder);
+                bool need_to_recreate_dependency_file = true;
+                FileTimeUnit dependency_time;
+                if (state.stat_cache.get_time(dependency_path, dependency_time)) {
+                    s32 compare;
+                    if (compare_file_time_with_provided(file, dependency_time, compare, &state.stat_cache)) {
+                        if (compare > 0) need_to_recreate_dependency_file = false;
+                        // Touched file with the same content includes the same headers
+                        else if (content_hash && state.database.check_content(state.database.intern_path(file)) == Result::SL_FALSE)
+                            need_to_recreate_dependency_file = false;
+                    }
+                }
+                if (!force_rebuilt && !need_to_recreate_dependency_file) continue;
+                state.stat_cache.invalidate(dependency_path);
+
+                while (scan_procs.count() >= max_procs || !scan_procs.reserve_slot()) {
+                    if (!wait_scan())
+                        return false;
+                }
+                FileHandle dependency_file;
+                if (!create_file(dependency_path, dependency_file)) return false;
+
+                CmdOptions options = {};
+                options.reset_command = false;
+                options.stdout_desc = &dependency_file;
+                options.async = &scan_procs;
+                if (compiler == FlagsCompiler::MSVC) {
+                    // MSVC will generate obj file, even we asking it not to do that
+                    // so we will redirect it to trash (where it belongs).
+                    append("/c /showIncludes /Fo:");
+                    append(_output_folder);
+                    append("/.trash.obj ");
+                } else
+                    append("-MM ");
+                append(file.data, file.size);
+                Process proc;
+                {
+                    ScopedLogger _(logger_muted);
+                    proc = execute(options);
+                }
+                if (state.trace && proc.id != INVALID_PROCESS) state.trace->begin("scan", file, StrView(_data, _count), proc.id);
+                // Child process has its own copy of the handle
+                close_file(dependency_file);
+                this->_count = mark;
+                if (proc.id == INVALID_PROCESS) {
+                    log_error("Failed to get dependencies of \"" SV_FORMAT "\"\n", SV_ARG(file));
+                    return false;
+                }
+                scan_jobs.push(SourceJob{proc.id, i});
+            }
+            while (scan_procs.count() > 0) {
+                if (!wait_scan())
+                    return false;
+            }
+        }
+        // Check which C/C++ files have to be rebuilt
+        Array<bool> stale_sources(get_global_allocator());
+        Array<bool> flags_changed_sources(get_global_allocator());
+        for (usize i = 0; i < source_files.count(); ++i) {
+            auto& file = source_files[i];
+            const auto output_file_object_path = get_object_path(output_file_object, file, _output_folder);
+            // Every object is compiled again with rebuilt precompiled header, link follows from that
+            bool needs_compile = force_rebuilt || pch_rebuilt || file_needs_rebuilt_cpp(output_file_object_path, file, _output_folder, _custom_compiler, &state.stat_cache, &state.database) != Result::SL_FALSE;
+            bool flags_changed = false;
+            if (!needs_compile) {
+                // Object is up to date, but it could be compiled with different flags
+                // (Objects without known command hash are rebuilt, since we can't prove otherwise)
+                auto* record = state.database.find_record(output_file_object_path);
+                flags_changed = !record || record->command_hash != state.command_hash;
+            }
+            stale_sources.push(needs_compile || flags_changed);
+            flags_changed_sources.push(flags_changed);
+        }
+        // Files to compile are either sources or generated unity translation units
+        Array<bool> compile_flags_changed(get_global_allocator());
+        if (unity_build) {
+            if (!plan_unity_build(state.database, &state.stat_cache, state.command_hash, stale_sources, state.compile_files, state.link_objects))
+                return false;
+            for (usize i = 0; i < state.compile_files.count(); ++i)
+                compile_flags_changed.push(false);
+        } else {
+            for (usize i = 0; i < source_files.count(); ++i) {
+                if (stale_sources[i]) {
+                    state.compile_files.push(source_files[i]);
+                    compile_flags_changed.push(flags_changed_sources[i]);
+                }
+                StrBuilder object_path(get_global_allocator());
+                state.link_objects.push(get_object_path(object_path, source_files[i], _output_folder));
+            }
+        }
+        // Files that took longest to compile last time are started first, so they don't end up at the tail of the build.
+        //  Compile time of new files is estimated from their size (with average time per byte of known files)
+        {
+            Array<u64> predicted(get_global_allocator());
+            u64 known_time = 0;
+            u64 known_size = 0;
+            for (auto& file : state.compile_files) {
+                u64 size = 0;
+                state.stat_cache.get_size(file, size);
+                const auto compile_time = state.database.path_infos[state.database.intern_path(file)].compile_time;
+                if (compile_time > 0) {
+                    known_time += compile_time;
+                    known_size += size;
+                }
+                predicted.push(compile_time > 0 ? compile_time : size);
+            }
+            const double time_per_byte = known_size > 0 ? (double)known_time / (double)known_size : 1.0;
+            for (usize i = 0; i < state.compile_files.count(); ++i) {
+                if (state.database.path_infos[state.database.intern_path(state.compile_files[i])].compile_time == 0)
+                    predicted[i] = (u64)((double)predicted[i] * time_per_byte);
+            }
+            // Stable insertion sort, so files with the same prediction keep their order
+            for (usize i = 1; i < state.compile_files.count(); ++i) {
+                const auto file = state.compile_files[i];
+                const bool flags_changed = compile_flags_changed[i];
+                const auto time = predicted[i];
+                usize position = i;
+                while (position > 0 && predicted[position - 1] < time) {
+                    state.compile_files[position] = state.compile_files[position - 1];
+                    compile_flags_changed[position] = compile_flags_changed[position - 1];
+                    predicted[position] = predicted[position - 1];
+                    --position;
+                }
+                state.compile_files[position] = file;
+                compile_flags_changed[position] = flags_changed;
+                predicted[position] = time;
+            }
+        }
+        // Parallel compiles are limited by memory too, peak memory of every file is expected to be the same as last time
+        state.memory_budget = memory_budget > 0 ? memory_budget : get_system_info().available_memory;
+        {
+            u64 known_memory = 0;
+            u64 known_count = 0;
+            for (auto& info : state.database.path_infos) {
+                if (info.compile_memory == 0) continue;
+                known_memory += info.compile_memory;
+                ++known_count;
+            }
+            state.average_compile_memory = known_count > 0 ? known_memory / known_count : 0;
+        }
+        if (use_object_cache) {
+            state.manifest_keys.reserve(state.compile_files.count());
+            state.manifest_keys.set_count(state.compile_files.count());
+            state.restored_from_cache.reserve(state.compile_files.count());
+            state.restored_from_cache.set_count(state.compile_files.count());
+            for (usize i = 0; i < state.compile_files.count(); ++i) {
+                state.manifest_keys[i] = 0;
+                state.restored_from_cache[i] = false;
+            }
+        }
+        state.compile_commands.reserve(state.compile_files.count());
+        state.compile_commands.set_count(state.compile_files.count());
+        for (usize i = 0; i < state.compile_files.count(); ++i)
+            state.compile_commands[i] = StrView("");
+        if (state.compile_files.count() > 0)
+            state.needs_to_rebuilt = true;
+        for (usize i = 0; i < state.compile_files.count(); ++i) {
+            auto& file = state.compile_files[i];
+            const auto output_file_object_path = get_object_path(output_file_object, file, _output_folder);
+            build_tree_of_folders(file);
+            if (use_object_cache) {
+                if (!get_cache_manifest_key(state.command_hash, compiler_identity, file, state.manifest_keys[i]))
+                    state.manifest_keys[i] = 0;
+                const auto dependency_path = get_dependency_path(dependency_file_path, file, compiler, _output_folder);
+                if (state.manifest_keys[i] != 0 && object_cache_fetch(_object_cache_folder, state.manifest_keys[i], output_file_object_path, dependency_path)) {
+                    ++cache_hits;
+                    state.restored_from_cache[i] = true;
+                    log_info("Restored from cache: " SV_FORMAT "\n", SV_ARG(file));
+                    continue;
+                }
+                ++cache_misses;
+            }
+            if (compile_flags_changed[i])
+                log_info("Rebuilding: " SV_FORMAT " (build flags changed)\n", SV_ARG(file));
+            else
+                log_info("Rebuilding: " SV_FORMAT "\n", SV_ARG(file));
+            state.compile_commands[i] = get_compile_command(compiler, file, mark);
+        }
+        // Workers are asked for their slots only when there is something to compile
+        bool has_compile_jobs = false;
+        for (auto& command : state.compile_commands)
+            has_compile_jobs |= command.size > 0;
+        state.local_slots = (u32)max_procs;
+        state.remote_workers.clear();
+        state.remote_slots = 0;
+        if (has_compile_jobs && remote_workers.count() > 0) {
+            if (compiler == FlagsCompiler::MSVC || _precompiled_header.size > 0 || time_trace) {
+                log_warning("Remote workers are used only with GCC or Clang, without precompiled header and time trace\n");
+            } else {
+                for (usize i = 0; i < remote_workers.count(); ++i) {
+                    const auto& address = remote_workers[i];
+                    RemoteWorker worker;
+                    worker.address = address;
+                    worker.secret = remote_worker_secrets[i];
+                    {
+                        ScopedLogger _(logger_muted);
+                        worker.slots = query_remote_worker(address, worker.secret, &worker.running);
+                    }
+                    if (worker.slots == 0) {
+                        log_warning("Remote worker \"" SV_FORMAT "\" is not available\n", SV_ARG(address));
+                        continue;
+                    }
+                    state.remote_workers.push(worker);
+                    // Slots, which are taken by other clients, stay taken for this build
+                    state.remote_slots += worker.slots - MIN(worker.running, worker.slots);
+                }
+            }
+        }
+        return true;
+    }
+
+    StrView Cmd::get_compile_command(FlagsCompiler compiler, StrView file, usize mark)
+    {
+        StrBuilder dependency_file_path(get_global_allocator());
+        StrBuilder object_file_path(get_global_allocator());
+        this->_count = mark;
+        append_precompiled_header_flags(compiler);
+        if (compiler == FlagsCompiler::MSVC)
+            append("/c ");
+        else
+            append("-c ");
+        append(file.data, file.size);
+        append(' ');
+        if (single_pass_dependencies) {
+            if (compiler == FlagsCompiler::MSVC)
+                append("/sourceDependencies ");
+            else
+                append("-MMD -MF ");
+            append(get_dependency_path(dependency_file_path, file, compiler, _output_folder));
+            append(' ');
+        }
+        if (time_trace)
+            append("-ftime-trace ");
+        push_flag_output(compiler, true);
+        append(get_object_path(object_file_path, file, _output_folder));
+        // Only part after compiler flags is stored, see execute_compile_job()
+        StrBuilder command(get_global_allocator());
+        command.append(_data + mark, _count - mark);
+        this->_count = mark;
+        return command.to_string_view();
+    }
+
+    // Compile command has to be in the buffer of cmd. Child process preprocesses the file (writing dependency file too),
+    //  sends it to worker and writes received object, if worker couldn't be reached, it compiles the file by itself
+    static Process execute_remote_compile(Cmd& cmd, BuildState& state, usize job, const RemoteWorker& worker, Processes& procs)
+    {
+    #if defined(_WIN32)
+        UNUSED(cmd);
+        UNUSED(state);
+        UNUSED(job);
+        UNUSED(worker);
+        UNUSED(procs);
+        return Process();
+    #else
+        const auto& file = state.compile_files[job];
+        const auto address = worker.address;
+        StrBuilder object_path_buffer(get_global_allocator());
+        StrBuilder dependency_path_buffer(get_global_allocator());
+        StrBuilder preprocessed_path(get_global_allocator());
+        const auto object_path = get_object_path(object_path_buffer, file, cmd._output_folder);
+        preprocessed_path.append(object_path);
+        preprocessed_path.append(cmd.is_cpp ? ".ii" : ".i"); // Compiler knows from extension, that file is preprocessed
+        preprocessed_path.append_null(false);
+        StrBuilder local_command(get_global_allocator());
+        local_command.append(cmd.data(), cmd.count());
+        local_command.append_null(false);
+        StrView flags(cmd.data(), state.mark);
+        flags.trim_right();
+
+        cmd.set_count(state.mark);
+        cmd.append("-E ");
+        cmd.append(file);
+        cmd.append(' ');
+        if (cmd.single_pass_dependencies) {
+            cmd.append("-MMD -MF ");
+            cmd.append(get_dependency_path(dependency_path_buffer, file, cmd.get_effective_compiler(), cmd._output_folder));
+            cmd.append(" -MT ");
+            cmd.append(object_path);
+            cmd.append(' ');
+        }
+        cmd.append("-o ");
+        cmd.append(preprocessed_path.to_string_view());
+        cmd.append_null(false);
+        log_info("CMD (" SV_FORMAT "): " SV_FORMAT "\n", SV_ARG(address), SV_ARG(local_command.to_string_view()));
+        // Buffered output would be written twice otherwise
+        fflush(stdout);
+        const pid_t child = fork();
+        if (child < 0) {
+            report_error("Could not fork child process");
+            return Process();
+        }
+        if (child == 0) {
+            signal(SIGPIPE, SIG_IGN);
+            CmdOptions options = {};
+            options.print_command = false;
+            options.reset_command = false;
+            int exit_code = cmd.execute(options).exit_code;
+            if (exit_code == 0) {
+                exit_code = run_remote_compile(address, worker.secret, flags, cmd.is_cpp, preprocessed_path.to_string_view(true), object_path);
+                if (exit_code < 0) {
+                    log_warning("Remote compile of " SV_FORMAT " failed, it's compiled locally\n", SV_ARG(file));
+                    cmd.reset();
+                    cmd.append(local_command.to_string_view());
+                    exit_code = cmd.execute(options).exit_code;
+                }
+            }
+            delete_file(preprocessed_path.to_string_view(true));
+            fflush(stdout);
+            _exit(exit_code > 0 && exit_code < 256 ? exit_code : (exit_code == 0 ? EXIT_SUCCESS : EXIT_FAILURE));
+        }
+        Process proc(child);
+        proc.is_remote = true;
+        procs.push(proc);
+        procs.release_unused_slots();
+        if (state.trace) state.trace->begin("remote compile", file, local_command.to_string_view(), proc.id);
+        return proc;
+    #endif // !_WIN32
+    }
+
+    // Remote jobs don't need jobserver token, so they can be started, when local ones can't
+    static bool has_free_remote_slot(BuildState& state)
+    {
+        for (auto& worker : state.remote_workers) {
+            if (worker.running < worker.slots) return true;
+        }
+        return false;
+    }
+
+    Process Cmd::execute_compile_job(BuildState& state, usize job, Processes& procs)
+    {
+        // Job goes to the least loaded of local processes and remote workers, local processes win a tie.
+        //  Local process needs jobserver token, token of remote job is given back in execute_remote_compile()
+        s32 worker_index = -1;
+        const bool has_local_slot = state.local_running < state.local_slots && procs.reserve_slot();
+        double lowest_load = has_local_slot ? (double)state.local_running / state.local_slots : 2.0;
+        for (usize i = 0; i < state.remote_workers.count(); ++i) {
+            auto& worker = state.remote_workers[i];
+            if (worker.running >= worker.slots) continue;
+            const double load = (double)worker.running / worker.slots;
+            if (load < lowest_load) {
+                lowest_load = load;
+                worker_index = (s32)i;
+            }
+        }
+        this->_count = state.mark;
+        append(state.compile_commands[job]);
+        append_null(false);
+        Process proc;
+        if (worker_index < 0) {
+            CmdOptions options = {};
+            options.reset_command = false;
+            options.async = &procs;
+            options.job_server = procs.job_server;
+            proc = execute(options);
+            if (state.trace && proc.id != INVALID_PROCESS) state.trace->begin("compile", state.compile_files[job], StrView(_data, _count), proc.id);
+        } else {
+            proc = execute_remote_compile(*this, state, job, state.remote_workers[worker_index], procs);
+        }
+        this->_count = state.mark;
+        while (state.job_processes.count() <= job) {
+            state.job_processes.push(INVALID_PROCESS);
+            state.job_start_times.push(0u);
+            state.job_durations.push(0u);
+            state.job_memory.push(0u);
+            state.job_peak_memory.push(0u);
+            state.job_workers.push(-1);
+        }
+        if (proc.id == INVALID_PROCESS) return proc;
+        state.job_processes[job] = proc.id;
+        state.job_start_times[job] = get_monotonic_time();
+        state.job_workers[job] = worker_index;
+        if (worker_index < 0) {
+            ++state.local_running;
+            state.job_memory[job] = predict_job_memory(state, job);
+            state.running_memory += state.job_memory[job];
+        } else {
+            ++state.remote_workers[worker_index].running;
+            state.job_memory[job] = 0;
+        }
+        return proc;
+    }
+
+    void Cmd::finish_compile_job(BuildState& state, const Process& finished)
+    {
+        if (state.trace) state.trace->end(finished);
+        for (usize job = 0; job < state.job_processes.count(); ++job) {
+            if (state.job_processes[job] != finished.id) continue;
+            state.job_processes[job] = INVALID_PROCESS;
+            state.running_memory -= state.job_memory[job];
+            const bool is_remote = state.job_workers[job] >= 0;
+            if (is_remote) --state.remote_workers[state.job_workers[job]].running;
+            else           --state.local_running;
+            // Failed compiles don't tell how long the file takes to compile
+            if (!finished.error_happened) {
+                state.job_durations[job] = MAX(get_monotonic_time() - state.job_start_times[job], (u64)1);
+                // Local process of remote job only preprocessed the file, its memory would be misleading
+                if (!is_remote) state.job_peak_memory[job] = finished.peak_memory;
+            }
+            return;
+        }
+    }
+
+    u64 Cmd::predict_job_memory(BuildState& state, usize job)
+    {
+        const auto memory = state.database.path_infos[state.database.intern_path(state.compile_files[job])].compile_memory;
+        return memory > 0 ? memory : state.average_compile_memory;
+    }
+
+    bool Cmd::fits_memory_budget(BuildState& state, usize job, usize running_processes)
+    {
+        // Job, that doesn't fit even alone, is still started, when nothing else runs
+        if (running_processes == 0 || state.memory_budget == 0) return true;
+        return state.running_memory + predict_job_memory(state, job) <= state.memory_budget;
+    }
+
+    bool Cmd::finish_compiles(BuildState& state, bool& needs_link_out)
     {
-        auto cpp_index = file.find_last(".cpp");
-        if (cpp_index == StrView::INVALID_INDEX) {
-            cpp_index = file.find_last(".c");
+        const auto compiler = get_effective_compiler();
+        const bool use_object_cache = _object_cache_folder.size > 0;
+        StrBuilder output_file_object(get_global_allocator());
+        StrBuilder dependency_file_path(get_global_allocator());
+        this->_count = state.mark;
+        for (usize i = 0; i < state.compile_files.count(); ++i) { // Remember dependencies of freshly compiled objects
+            auto& file = state.compile_files[i];
+            const auto object_path = get_object_path(output_file_object, file, _output_folder);
+            FileTimeUnit object_time;
+            Array<StrView> deps(get_global_allocator());
+            ScopedLogger _(logger_muted);
+            // Compiler has just written object and dependency file
+            state.stat_cache.invalidate(object_path);
+            state.stat_cache.invalidate(get_dependency_path(dependency_file_path, file, compiler, _output_folder));
+            if (!get_file_write_time(object_path, object_time, &state.stat_cache)) continue;
+            if (!read_unescaped_dependencies(file, deps, _output_folder, _custom_compiler)) continue;
+            state.database.update_record(object_path, file, deps, object_time, state.command_hash);
+            if (i < state.job_durations.count() && state.job_durations[i] > 0) {
+                auto& info = state.database.path_infos[state.database.intern_path(file)];
+                info.compile_time = state.job_durations[i];
+                if (state.job_peak_memory[i] > 0) info.compile_memory = state.job_peak_memory[i];
+            }
+            if (use_object_cache && !state.restored_from_cache[i] && state.manifest_keys[i] != 0) {
+                const auto dependency_path = get_dependency_path(dependency_file_path, file, compiler, _output_folder);
+                object_cache_store(_object_cache_folder, state.manifest_keys[i], deps, object_path, dependency_path);
+            }
+            if (content_hash) {
+                // Object was compiled from current content of all its files
+                state.database.check_content(state.database.intern_path(file));
+                for (auto& dependency : deps)
+                    state.database.check_content(state.database.intern_path(dependency));
+            }
         }
-        if (cpp_index != StrView::INVALID_INDEX) {
-            file.chop_right(file.size - cpp_index);
+        if (use_object_cache && (cache_hits != state.saved_cache_hits || cache_misses != state.saved_cache_misses))
+            log_info("Object cache: %u hits, %u misses\n", cache_hits - state.saved_cache_hits, cache_misses - state.saved_cache_misses);
+
+        // Link step is its own node: it runs when any object was rebuilt, when executable is missing or older
+        //  than any of the objects, or when link command (objects, libraries, linker flags) is changed
+        const bool is_static_library = executable_type == FlagsExecutableType::STATIC_LIB;
+        const auto output_path = state.output_path;
+        if (is_static_library) {
+            _count = 0;
+            append_archive_command(compiler, output_path);
+        } else {
+            append_custom_flags();
+            append_output_name(compiler);
+            if (executable_type == FlagsExecutableType::DYNAMIC_LIB)
+                append(compiler == FlagsCompiler::MSVC ? "/LD " : "-shared ");
         }
-        return file;
+        for (auto& object : state.link_objects) {
+            append(object);
+            append(' ');
+        }
+        if (_precompiled_header.size > 0 && compiler == FlagsCompiler::MSVC) {
+            append(get_precompiled_header_path(output_file_object, _precompiled_header, compiler, _output_folder));
+            append(".obj ");
+        }
+        if (!is_static_library) {
+            append_linker_flags(compiler);
+            append_libraries_paths();
+            append_libraries();
+        }
+        state.link_hash = get_command_fingerprint();
+        const auto link_hash = state.link_hash;
+        bool needs_link = state.needs_to_rebuilt;
+        // Objects that are newer than existing output, archive can be updated only with them
+        Array<StrView> changed_objects(get_global_allocator());
+        bool can_update_archive = false;
+        {
+            ScopedLogger _(logger_muted);
+            FileTimeUnit output_time;
+            auto* link = state.database.find_link(output_path);
+            if (!get_file_write_time(output_path, output_time, &state.stat_cache) || !link || link->command_hash != link_hash) {
+                needs_link = true;
+            } else {
+                for (auto& object : state.link_objects) {
+                    FileTimeUnit object_time;
+                    if (!get_file_write_time(object, object_time, &state.stat_cache) || compare_file_time(output_time, object_time) < 0) {
+                        needs_link = true;
+                        changed_objects.push(object);
+                    }
+                }
+                // Same command means same members, so "ar r" replacing only changed ones gives the same archive
+                can_update_archive = is_static_library && compiler != FlagsCompiler::MSVC;
+            }
+        }
+        needs_link_out = needs_link;
+        if (!needs_link) {
+            _count = 0;
+            return true;
+        }
+        if (is_static_library) {
+            if (can_update_archive) {
+                _count = 0;
+                append_archive_command(compiler, output_path);
+                for (auto& object : changed_objects) {
+                    append(object);
+                    append(' ');
+                }
+                log_info("Updating static library...\n");
+            } else {
+                // Archive is created from scratch, so removed objects don't stay in it
+                {
+                    ScopedLogger _(logger_muted);
+                    delete_file(output_path);
+                }
+                log_info("Creating static library...\n");
+            }
+        } else if (executable_type == FlagsExecutableType::DYNAMIC_LIB)
+            log_info("Linking dynamic library...\n");
+        else
+            log_info("Linking executable...\n");
+        return true;
     }
 
-    void Cmd::build_tree_of_folders(StrView file)
+    void Cmd::finish_link(BuildState& state, bool linked)
     {
-        LocalArray<StrView> folders(get_global_allocator());
-        file.split_by_char(folders, '/');
-        StrBuilder tree(get_global_allocator());
-        tree.append(this->_output_folder);
-        auto folders_count = folders.count();
-        if (folders_count < 1) return;
-        for (usize i = 0; i < folders_count - 1; ++i) {
-            auto folder = folders[i];
-            tree.append('/');
-            tree.append(folder);
-            tree.append_null(false);
-            create_folder(tree.to_string_view(true));
+        if (linked) {
+            ScopedLogger _(logger_muted);
+            FileTimeUnit output_time;
+            state.stat_cache.invalidate(state.output_path);
+            if (get_file_write_time(state.output_path, output_time, &state.stat_cache))
+                state.database.update_link(state.output_path, state.link_hash);
         }
+        if (!state.database.save())
+            log_warning("Next build would need to read all dependency files again\n");
     }
 
     bool Cmd::end_build(bool run, bool force_rebuilt)
@@ -2162,186 +5878,651 @@ namespace Sl
         }
         const auto compiler = get_effective_compiler();
         bool result = false;
-        bool needs_to_rebuilt = false;
         if (source_files.count() < 1) {
             log_error("No source files were provided. Use add_source_file() to add some.\n");
             ASSERT_DEBUG(source_files.count() > 1);
             return false;
         }
 
+        BuildTrace trace;
+        BuildTrace* build_trace = _trace_file.size > 0 ? &trace : nullptr;
+        // Trace is most useful, when build failed or took long, so it's written in any case
+        auto fail = [&]() -> bool {
+            if (build_trace) trace.write(_trace_file);
+            return false;
+        };
         if (incremental_build) {
-            ASSERT_TRUE(source_files.count() == source_files_output.count());
-            create_folder(this->_output_folder);
-            append_custom_flags();
-            append_defines();
-            { // Check if executable file exist
-                StrBuilder output_full_name(get_global_allocator());
-                output_full_name.append(output_name.data, output_name.size);
-                #if defined(_WIN32)
-                    if (!output_contains_ext) {
-                        output_full_name.append(".exe");
-                    }
-                #endif // !_WIN32
-                output_full_name.append_null(false);
-
-                if (!is_file_exists(output_full_name.to_string_view(true)))
-                    force_rebuilt = true;
-            }
-
+            BuildState state;
+            state.trace = build_trace;
+            if (!prepare_build(state, force_rebuilt))
+                return fail();
             Processes procs = {};
-            const auto max_procs = max_concurrent_processes == 0 ? get_system_info().number_of_processors * 2 + 1 : max_concurrent_processes;
-            StrBuilder output_file_object(get_global_allocator());
-
-            HashMapOptions opt{};
-            opt.allocator = get_global_allocator();
-            HashMap<StrView, FileTimeUnit, StrView::hash> memoization(opt);
-
-            const auto mark = this->_count;
-            for (auto& file : source_files) {
-                // Create dependency
-                build_tree_of_folders(file);
-                output_file_object.clear();
-                output_file_object.append(_output_folder);
-                output_file_object.append('/');
-                output_file_object.append(strip_cpp_postfix(file));
-                if (compiler == FlagsCompiler::MSVC)
-                    output_file_object.append("_cl.d");
-                else
-                    output_file_object.append(".d");
-                output_file_object.append_null(false);
-                const auto dependency_path = output_file_object.to_string_view(true);
-                bool need_to_recreate_dependency_file = true;
-                {
-                    ScopedLogger _(logger_muted);
-                    if (is_file_exists(dependency_path)) {
-                        FileHandle dependency_file;
-                        if (open_file(dependency_path, dependency_file)) {
-                            FileTime dependency_time;
-                            if (get_file_time(dependency_file, dependency_time)) {
-                                s32 compare;
-                                if (compare_file_time_with_provided(file, dependency_time.last_write_time, compare)) {
-                                    if (compare > 0) need_to_recreate_dependency_file = false;
-                                }
-                            }
-                            close_file(dependency_file);
-                        }
-                    }
-                }
-                if (force_rebuilt || need_to_recreate_dependency_file) {
-                    FileHandle dependency_file;
-                    if (!create_file(dependency_path, dependency_file)) return false;
-
-                    CmdOptions options = {};
-                    options.reset_command = false;
-                    options.stdout_desc = &dependency_file;
-                    if (compiler == FlagsCompiler::MSVC) {
-                        // MSVC will generate obj file, even we asking it not to do that
-                        // so we will redirect it to trash (where it belongs).
-                        append("/c /showIncludes /Fo:");
-                        append(_output_folder);
-                        append("/.trash.obj ");
-                    } else
-                        append("-MM ");
-                    append(file.data, file.size);
-                    {
-                        auto saved_logger = log_get_current();
-                        log_set_current(logger_muted);
-                        if (!execute(options).wait()) {
-                            log_set_current(saved_logger);
-                            log_error("Failed to get dependencies of \"" SV_FORMAT "\"", SV_ARG(file));
-                            return false;
-                        }
-                        close_file(dependency_file);
-                        log_set_current(saved_logger);
-                    }
-                }
-                this->_count = mark;
-                // Check and rebuild C/C++ file if needed
-                output_file_object.clear();
-                output_file_object.append(_output_folder);
-                output_file_object.append('/');
-                output_file_object.append(file.data, file.size);
-                output_file_object.append(".obj");
-                output_file_object.append_null(false);
-                const auto output_file_object_path = output_file_object.to_string_view(true);
-                if (force_rebuilt || file_needs_rebuilt_cpp(output_file_object_path, file, _output_folder, _custom_compiler, &memoization) != Result::SL_FALSE)
-                {
-                    if (compiler == FlagsCompiler::MSVC)
-                        append("/c ");
-                    else
-                        append("-c ");
-                    append(file.data, file.size);
-                    needs_to_rebuilt = true;
-                    log_info("Rebuilding: " SV_FORMAT "\n", SV_ARG(file));
-                    append(' ');
-                    push_flag_output(compiler, true);
-                    append(output_file_object_path);
-                    append_null(false);
-                    CmdOptions options = {};
-                    options.reset_command = false;
-                    options.async = &procs;
-                    if (procs.count() >= max_procs) {
-                        if (!procs.wait_all())
-                            return false;
-                    }
-                    execute(options);
+            const usize max_procs = max_concurrent_processes == 0 ? get_system_info().number_of_processors * 2 + 1 : max_concurrent_processes;
+            procs.job_server = get_job_server(max_procs);
+            auto wait_compile = [&]() -> bool {
+                Process finished;
+                const bool success = procs.wait_any(&finished);
+                finish_compile_job(state, finished);
+                return success;
+            };
+            for (usize i = 0; i < state.compile_commands.count(); ++i) {
+                if (state.compile_commands[i].size == 0) continue; // Restored from object cache
+                // Sliding window: start next compile as soon as any slot (and enough memory) is free
+                while (procs.count() >= max_procs + state.remote_slots || !fits_memory_budget(state, i, procs.count()) || !(procs.reserve_slot() || has_free_remote_slot(state))) {
+                    if (!wait_compile())
+                        return fail();
                 }
-                this->_count = mark;
+                execute_compile_job(state, i, procs);
             }
-            if (!procs.wait_all())
-                return false;
-            if (needs_to_rebuilt) {
-                append_custom_flags();
-                append_output_name(compiler);
-                for (auto& file : source_files) {
-                    append(this->_output_folder);
-                    append('/');
-                    append(file.data, file.size);
-                    append(".obj");
-                    append(' ');
-                }
-                append_linker_flags(compiler);
-                append_libraries_paths();
-                append_libraries();
-                log_info("Linking executable...\n");
-                result = execute().wait();
+            bool compiled = true;
+            while (procs.count() > 0)
+                compiled = wait_compile() && compiled;
+            if (!compiled)
+                return fail();
+            bool needs_link;
+            if (!finish_compiles(state, needs_link))
+                return fail();
+            if (needs_link) {
+                CmdOptions options = {};
+                options.job_server = procs.job_server;
+                result = execute_traced(*this, build_trace, "link", state.output_path, options);
             } else {
-                _count = 0;
                 result = true;
-                log_info("Everything is up to date\n");
+                log_info("Everything is up to date (%u file system queries)\n", state.stat_cache.stat_calls);
+            }
+            finish_link(state, needs_link && result);
+            if (time_trace) {
+                // Clang names trace after object file, replacing its extension with .json
+                Array<StrView> trace_files(get_global_allocator());
+                for (auto object : state.link_objects) {
+                    const auto dot_index = object.find_last(".");
+                    if (dot_index != StrView::INVALID_INDEX) object.chop_right(object.size - dot_index);
+                    StrBuilder trace_file(get_global_allocator());
+                    trace_file.append(object);
+                    trace_file.append(".json");
+                    trace_file.append_null(false);
+                    trace_files.push(trace_file.to_string_view(true));
+                }
+                report_time_trace(trace_files);
             }
         }
         else {
             append_custom_flags();
             append_defines();
+            if (_precompiled_header.size > 0) {
+                create_folder(this->_output_folder);
+                bool pch_rebuilt;
+                if (!build_precompiled_header(compiler, pch_rebuilt, nullptr, nullptr, build_trace))
+                    return fail();
+                // Sources are compiled by the same command as linked
+                append_precompiled_header_flags(compiler);
+            }
             append_output_name(compiler);
+            if (executable_type == FlagsExecutableType::DYNAMIC_LIB)
+                append(compiler == FlagsCompiler::MSVC ? "/LD " : "-shared ");
             for (auto& file : source_files) {
                 append(file.data, file.size);
                 append(' ');
             }
+            if (_precompiled_header.size > 0 && compiler == FlagsCompiler::MSVC) {
+                StrBuilder pch_object(get_global_allocator());
+                append(get_precompiled_header_path(pch_object, _precompiled_header, compiler, _output_folder));
+                append(".obj ");
+            }
             append_linker_flags(compiler);
             append_libraries_paths();
             append_libraries();
             log_info("Linking executable...\n");
-            result = execute().wait();
+            result = execute_traced(*this, build_trace, "link", output_name);
         }
-        if (result && run) {
-            _count = 0;
-            append_output_name(compiler, false);
-            log_info("Running: " SB_FORMAT "\n", (int)_count, _data);
-            for (auto& arg : custom_arguments) {
-                append(arg);
-                append(' ');
-            }
-            trim();
-            CmdOptions opt;
-            opt.print_command = false;
-            execute(opt).wait();
+        if (result && run && executable_type != FlagsExecutableType::EXECUTABLE) {
+            log_warning("Only executable can be run, library was built\n");
+            run = false;
         }
+        if (result && run)
+            run_output(compiler, build_trace);
+        if (build_trace) trace.write(_trace_file);
         clear();
         return result;
     }
 
+    void Cmd::run_output(FlagsCompiler compiler, BuildTrace* trace)
+    {
+        _count = 0;
+        append_output_name(compiler, false);
+        log_info("Running: " SB_FORMAT "\n", (int)_count, _data);
+        for (auto& arg : custom_arguments) {
+            append(arg);
+            append(' ');
+        }
+        trim();
+        CmdOptions opt;
+        opt.print_command = false;
+        execute_traced(*this, trace, "run", output_name, opt);
+    }
+
+    // Collapses "." and "folder/.." parts, so the same file spelled differently in dependency files and
+    //  in file system events (or by user) is compared as one path
+    static StrView get_normal_path(StrBuilder& builder, StrView path)
+    {
+        builder.clear();
+        const bool is_absolute = path.size > 0 && path.first() == '/';
+        Array<StrView> parts(get_global_allocator());
+        while (path.size > 0) {
+            auto part = path;
+            const auto slash_index = path.find_first('/');
+            if (slash_index == StrView::INVALID_INDEX) {
+                path.chop_left(path.size);
+            } else {
+                part.chop_right(part.size - slash_index);
+                path.chop_left(slash_index + 1);
+            }
+            if (part.size == 0 || part == ".") continue;
+            if (part == ".." && parts.count() > 0 && parts.last() != "..") parts.pop();
+            else if (part != ".." || !is_absolute) parts.push(part);
+        }
+        if (is_absolute) builder.append('/');
+        for (usize i = 0; i < parts.count(); ++i) {
+            if (i > 0) builder.append('/');
+            builder.append(parts[i]);
+        }
+        if (builder.count() == 0) builder.append('.');
+        parts.cleanup();
+        return builder.to_string_view();
+    }
+
+    bool Cmd::watch_build(bool run)
+    {
+        if (!_build_started) {
+            log_error("You must call start_build() first\n");
+            exit(EXIT_FAILURE);
+        }
+        if (source_files.count() < 1) {
+            log_error("No source files were provided. Use add_source_file() to add some.\n");
+            return false;
+        }
+    #if !defined(__linux__)
+        UNUSED(run);
+        log_error("Watch mode is supported only on Linux\n");
+        return false;
+    #else
+        const auto compiler = get_effective_compiler();
+        // Only separate objects with dependency files written by compiler can be rebuilt one by one
+        incremental_build = true;
+        unity_build = false;
+        single_pass_dependencies = true;
+        if (run && executable_type != FlagsExecutableType::EXECUTABLE) {
+            log_warning("Only executable can be run, library will be built\n");
+            run = false;
+        }
+
+        BuildState state;
+        auto load_database = [&]() {
+            state.database.load(_output_folder);
+            state.database.use_content_hash = content_hash;
+        };
+        auto build_step = [&]() -> bool {
+            Processes procs = {};
+            const usize max_procs = max_concurrent_processes == 0 ? get_system_info().number_of_processors * 2 + 1 : max_concurrent_processes;
+            procs.job_server = get_job_server(max_procs);
+            bool success = true;
+            for (usize i = 0; i < state.compile_commands.count() && success; ++i) {
+                if (state.compile_commands[i].size == 0) continue;
+                while (success && (procs.count() >= max_procs + state.remote_slots || !fits_memory_budget(state, i, procs.count()) || !(procs.reserve_slot() || has_free_remote_slot(state)))) {
+                    Process finished;
+                    success = procs.wait_any(&finished);
+                    finish_compile_job(state, finished);
+                }
+                if (success) execute_compile_job(state, i, procs);
+            }
+            while (procs.count() > 0) {
+                Process finished;
+                success = procs.wait_any(&finished) && success;
+                finish_compile_job(state, finished);
+            }
+            bool needs_link = false;
+            bool result = success && finish_compiles(state, needs_link);
+            if (result && needs_link) {
+                CmdOptions options = {};
+                options.job_server = procs.job_server;
+                result = execute(options).wait();
+            }
+            // Database is saved and unmapped here, even if build failed
+            finish_link(state, needs_link && result);
+            state.stat_cache.clear();
+            return result;
+        };
+
+        if (!prepare_build(state, false))
+            return false;
+        // Global allocator is rewound after every rebuild, so state kept between rebuilds has its own allocator
+        ArenaAllocator watch_allocator;
+        // Compiler flags are the same for every rebuild
+        StrBuilder flags(&watch_allocator);
+        flags.append(_data, state.mark);
+        if (build_step() && run)
+            run_output(compiler);
+
+        const int inotify = inotify_init1(IN_CLOEXEC);
+        if (inotify < 0) {
+            report_error("Could not initialize inotify");
+            watch_allocator.cleanup();
+            return false;
+        }
+        Array<StrView> watched_folders(&watch_allocator);
+        Array<int> watch_descriptors(&watch_allocator);
+        StrBuilder normal_path(&watch_allocator);
+        auto watch_folder_of = [&](StrView path) {
+            auto folder = get_normal_path(normal_path, path);
+            const auto slash_index = folder.find_last("/");
+            if (slash_index == StrView::INVALID_INDEX) folder = ".";
+            else folder.chop_right(folder.size - slash_index);
+            for (auto& watched : watched_folders)
+                if (watched == folder) return;
+            StrBuilder folder_path(&watch_allocator);
+            folder_path.append(folder);
+            folder_path.append_null(false);
+            folder = folder_path.to_string_view(true);
+            // Editors usually save into temporary file and rename it afterwards
+            const int descriptor = inotify_add_watch(inotify, folder_path.data(), IN_CLOSE_WRITE | IN_MOVED_TO);
+            if (descriptor < 0) {
+                report_error("Could not watch folder \"" SV_FORMAT "\"", SV_ARG(folder));
+                return;
+            }
+            watched_folders.push(folder);
+            watch_descriptors.push(descriptor);
+        };
+        // Sources and every file they depend on are taken from build database, no dependency file is parsed.
+        //  Database is loaded only while it's needed, since its paths are in global allocator
+        auto watch_dependencies = [&]() {
+            load_database();
+            StrBuilder object_path(get_global_allocator());
+            for (auto& file : source_files) {
+                watch_folder_of(file);
+                auto* record = state.database.find_record(get_object_path(object_path, file, _output_folder));
+                if (!record) continue;
+                for (u32 i = 0; i < record->dependency_count; ++i)
+                    watch_folder_of(state.database.paths[state.database.dependencies[record->first_dependency + i]]);
+            }
+            if (_precompiled_header.size > 0) watch_folder_of(_precompiled_header);
+            state.database.cleanup();
+        };
+        watch_dependencies();
+
+        Array<StrView> failed_files(&watch_allocator);
+        alignas(inotify_event) char events[4096];
+        log_info("Watching for changes...\n");
+        while (true) {
+            // Everything, that this rebuild allocates from global allocator, is released after it
+            ScopedAllocator rebuild_scope;
+            Array<StrView> changed(get_global_allocator());
+            // After first event, events that come right after it are collected too, so one save is one rebuild
+            int timeout = -1;
+            while (true) {
+                pollfd descriptor = {inotify, POLLIN, 0};
+                const int ready = poll(&descriptor, 1, timeout);
+                if (ready < 0) {
+                    if (errno == EINTR) continue;
+                    report_error("Could not wait for file changes");
+                    close(inotify);
+                    watch_allocator.cleanup();
+                    return false;
+                }
+                if (ready == 0) break;
+                const ssize_t length = read(inotify, events, sizeof(events));
+                if (length <= 0) continue;
+                for (char* pointer = events; pointer < events + length;) {
+                    const auto* event = (const inotify_event*)pointer;
+                    pointer += sizeof(inotify_event) + event->len;
+                    if (event->len == 0) continue;
+                    for (usize i = 0; i < watch_descriptors.count(); ++i) {
+                        if (watch_descriptors[i] != event->wd) continue;
+                        StrBuilder path(get_global_allocator());
+                        StrBuilder normal(get_global_allocator());
+                        if (watched_folders[i] != ".") {
+                            path.append(watched_folders[i]);
+                            path.append('/');
+                        }
+                        path.append(event->name, strlen(event->name));
+                        changed.push(get_normal_path(normal, path.to_string_view()));
+                        break;
+                    }
+                }
+                timeout = 50;
+            }
+            const auto start_time = get_monotonic_time();
+
+            // Objects, which source or one of dependencies was changed, are compiled again.
+            //  Database paths are kept as dependency files spell them, so they are compared in their normal form.
+            //  One file can be spelled differently by several dependency files, so every match is taken
+            load_database();
+            Array<u32> changed_ids(get_global_allocator());
+            StrBuilder normal(get_global_allocator());
+            for (usize i = 0; i < state.database.paths.count(); ++i) {
+                const auto path = get_normal_path(normal, state.database.paths[i]);
+                for (auto& changed_path : changed) {
+                    if (changed_path != path) continue;
+                    changed_ids.push((u32)i);
+                    break;
+                }
+            }
+            Array<StrView> affected_sources(get_global_allocator());
+            state.database.find_affected_sources(changed_ids, affected_sources);
+            state.compile_files.set_count(0);
+            StrBuilder object_path(get_global_allocator());
+            for (auto& file : source_files) {
+                bool affected = !state.database.find_record(get_object_path(object_path, file, _output_folder));
+                for (auto& failed : failed_files)
+                    if (failed == file) affected = true;
+                for (auto& source : affected_sources)
+                    if (source == file) affected = true;
+                if (affected) state.compile_files.push(file);
+            }
+            if (state.compile_files.count() == 0) {
+                state.database.cleanup();
+                continue;
+            }
+
+            _count = 0;
+            append(flags.to_string_view());
+            state.compile_commands.set_count(0);
+            state.manifest_keys.set_count(0);
+            state.restored_from_cache.set_count(0);
+            state.job_processes.set_count(0);
+            state.job_start_times.set_count(0);
+            state.job_durations.set_count(0);
+            state.job_memory.set_count(0);
+            state.job_peak_memory.set_count(0);
+            for (auto& file : state.compile_files) {
+                log_info("Rebuilding: " SV_FORMAT "\n", SV_ARG(file));
+                state.compile_commands.push(get_compile_command(compiler, file, state.mark));
+                state.manifest_keys.push(0);
+                state.restored_from_cache.push(false);
+            }
+            state.needs_to_rebuilt = true;
+            failed_files.set_count(0);
+            if (build_step()) {
+                log_info("Rebuilt in %.1f ms\n", (double)(get_monotonic_time() - start_time) / 1000.0);
+                watch_dependencies();
+                if (run) run_output(compiler);
+            } else {
+                // Failed files are compiled again with next change, even if it's not related to them
+                for (auto& file : state.compile_files) failed_files.push(file);
+                watch_dependencies();
+                log_error("Build failed\n");
+            }
+            log_info("Watching for changes...\n");
+        }
+    #endif // __linux__
+    }
+
+    bool Cmd::find_affected_sources(StrView file, Array<StrView>& sources_out)
+    {
+        BuildDatabase database;
+        if (!database.load(_output_folder)) return false;
+        // Database paths are kept as dependency files spell them
+        StrBuilder file_normal(get_global_allocator());
+        StrBuilder normal(get_global_allocator());
+        const auto file_path = get_normal_path(file_normal, file);
+        Array<u32> path_ids(get_global_allocator());
+        for (usize i = 0; i < database.paths.count(); ++i) {
+            if (get_normal_path(normal, database.paths[i]) == file_path)
+                path_ids.push((u32)i);
+        }
+        Array<StrView> sources(get_global_allocator());
+        database.find_affected_sources(path_ids, sources);
+        // Paths point into database file, which is unmapped with database
+        for (auto& source : sources)
+            sources_out.push(StrView((const char*)memory_duplicate(*get_global_allocator(), source.data, source.size), source.size, true, source.is_wide));
+        database.cleanup();
+        return true;
+    }
+
+    usize BuildGraph::add_target(Cmd& target)
+    {
+        targets.push(&target);
+        return targets.count() - 1;
+    }
+
+    void BuildGraph::add_dependency(usize target, usize dependency)
+    {
+        ASSERT(target < targets.count() && dependency < targets.count(), "Provide ids returned by add_target()");
+        dependencies.push(Dependency{target, dependency});
+    }
+
+    bool BuildGraph::build(u32 max_concurrent_processes, bool force_rebuilt)
+    {
+        const usize count = targets.count();
+        for (usize i = 0; i < count; ++i) {
+            auto* target = targets[i];
+            if (!target->_build_started) {
+                log_error("You must call start_build() for every target first\n");
+                return false;
+            }
+            if (!target->incremental_build) {
+                log_error("Target \"" SV_FORMAT "\" has to be built incrementally\n", SV_ARG(target->output_name));
+                return false;
+            }
+            if (target->source_files.count() < 1) {
+                log_error("No source files were provided for target \"" SV_FORMAT "\"\n", SV_ARG(target->output_name));
+                return false;
+            }
+            for (usize j = 0; j < i; ++j) {
+                // Objects and build database of targets would overwrite each other
+                if (targets[j]->_output_folder == target->_output_folder) {
+                    log_error("Targets \"" SV_FORMAT "\" and \"" SV_FORMAT "\" must have different output folders\n",
+                              SV_ARG(targets[j]->output_name), SV_ARG(target->output_name));
+                    return false;
+                }
+            }
+        }
+
+        // Topological order of targets (Kahn's algorithm)
+        Array<usize> order(get_global_allocator());
+        Array<usize> waiting_for(get_global_allocator());
+        for (usize i = 0; i < count; ++i) waiting_for.push(0);
+        for (auto& dependency : dependencies) ++waiting_for[dependency.target];
+        for (usize i = 0; i < count; ++i)
+            if (waiting_for[i] == 0) order.push(i);
+        for (usize i = 0; i < order.count(); ++i) {
+            const auto current = order[i];
+            for (auto& dependency : dependencies)
+                if (dependency.dependency == current && --waiting_for[dependency.target] == 0)
+                    order.push(dependency.target);
+        }
+        if (order.count() != count) {
+            log_error("Build graph has a dependency cycle\n");
+            return false;
+        }
+
+        enum class TargetStage { COMPILING, LINK_PENDING, LINKING, DONE };
+        struct GraphJob
+        {
+            ProcessID id;
+            usize target;
+            bool is_link;
+        };
+        // States can't be moved (Array<> would move them), so they are constructed in place
+        auto* states = (BuildState*)get_global_allocator()->allocate(sizeof(BuildState) * count, alignof(BuildState));
+        for (usize i = 0; i < count; ++i) ::new (states + i) BuildState();
+        // One trace covers processes of all targets, it's written to trace file of every target, that has it
+        BuildTrace trace;
+        bool has_trace = false;
+        for (auto* target : targets) has_trace |= target->_trace_file.size > 0;
+        for (usize i = 0; i < count && has_trace; ++i) states[i].trace = &trace;
+        Array<TargetStage> stages(get_global_allocator());
+        Array<usize> next_job(get_global_allocator());
+        Array<usize> running_compiles(get_global_allocator());
+        Array<GraphJob> jobs(get_global_allocator());
+        for (usize i = 0; i < count; ++i) {
+            stages.push(TargetStage::COMPILING);
+            next_job.push(0);
+            running_compiles.push(0);
+        }
+
+        bool failed = false;
+        for (auto index : order) {
+            auto* target = targets[index];
+            if (!target->prepare_build(states[index], force_rebuilt)) {
+                failed = true;
+                break;
+            }
+            if (target->executable_type == FlagsExecutableType::STATIC_LIB) continue;
+            // Dependency libraries are linked like objects, so target is relinked when they change
+            for (auto& dependency : dependencies) {
+                if (dependency.target != index) continue;
+                auto* library = targets[dependency.dependency];
+                if (library->executable_type == FlagsExecutableType::EXECUTABLE) continue;
+                StrView library_path = states[dependency.dependency].output_path;
+                if (library->executable_type == FlagsExecutableType::DYNAMIC_LIB && library->get_effective_compiler() == FlagsCompiler::MSVC) {
+                    // MSVC links with import library of dll
+                    StrBuilder import_library(get_global_allocator());
+                    const auto extension_index = library_path.find_last(".dll");
+                    if (extension_index != StrView::INVALID_INDEX) library_path.chop_right(library_path.size - extension_index);
+                    import_library.append(library_path);
+                    import_library.append(".lib");
+                    import_library.append_null(false);
+                    library_path = import_library.to_string_view(true);
+                }
+                states[index].link_objects.push(library_path);
+            }
+        }
+
+        Processes procs = {};
+        const usize max_procs = max_concurrent_processes == 0 ? get_system_info().number_of_processors * 2 + 1 : max_concurrent_processes;
+        procs.job_server = get_job_server(max_procs);
+        // Targets usually share their remote workers, so slots of workers are counted once (the most of them)
+        u32 remote_slots = 0;
+        for (usize i = 0; i < count && !failed; ++i)
+            remote_slots = MAX(remote_slots, states[i].remote_slots);
+        // Memory budget is shared by all targets, the smallest one of them is used
+        u64 memory_budget = 0;
+        for (usize i = 0; i < count && !failed; ++i) {
+            if (states[i].memory_budget > 0 && (memory_budget == 0 || states[i].memory_budget < memory_budget))
+                memory_budget = states[i].memory_budget;
+        }
+        auto dependencies_done = [&](usize index) -> bool {
+            for (auto& dependency : dependencies)
+                if (dependency.target == index && stages[dependency.dependency] != TargetStage::DONE) return false;
+            return true;
+        };
+        while (!failed) {
+            // Targets, which objects and dependencies are ready, go to link step
+            bool changed = true;
+            while (changed && !failed) {
+                changed = false;
+                for (auto index : order) {
+                    auto& state = states[index];
+                    if (stages[index] != TargetStage::COMPILING || running_compiles[index] > 0
+                        || next_job[index] < state.compile_commands.count() || !dependencies_done(index)) continue;
+                    bool needs_link;
+                    if (!targets[index]->finish_compiles(state, needs_link)) {
+                        failed = true;
+                        break;
+                    }
+                    if (needs_link) {
+                        stages[index] = TargetStage::LINK_PENDING;
+                    } else {
+                        targets[index]->finish_link(state, false);
+                        log_info("\"" SV_FORMAT "\" is up to date (%u file system queries)\n", SV_ARG(state.output_path), state.stat_cache.stat_calls);
+                        stages[index] = TargetStage::DONE;
+                        changed = true;
+                    }
+                }
+            }
+            if (failed) break;
+            // Links are started first, since other targets may wait for them
+            for (auto index : order) {
+                if (procs.count() >= max_procs) break;
+                if (stages[index] != TargetStage::LINK_PENDING) continue;
+                if (!procs.reserve_slot()) break;
+                CmdOptions options = {};
+                options.async = &procs;
+                options.reset_command = false;
+                options.job_server = procs.job_server;
+                auto proc = targets[index]->execute(options);
+                if (proc.id != INVALID_PROCESS && has_trace)
+                    trace.begin("link", states[index].output_path, StrView(targets[index]->data(), targets[index]->count()), proc.id);
+                targets[index]->reset();
+                if (proc.id == INVALID_PROCESS) {
+                    failed = true;
+                    break;
+                }
+                jobs.push(GraphJob{proc.id, index, true});
+                stages[index] = TargetStage::LINKING;
+            }
+            // Compile jobs of all targets share the pool
+            for (auto index : order) {
+                auto& state = states[index];
+                while (!failed && procs.count() < max_procs + remote_slots && next_job[index] < state.compile_commands.count()) {
+                    const auto job = next_job[index];
+                    if (state.compile_commands[job].size == 0) { // Restored from object cache
+                        ++next_job[index];
+                        continue;
+                    }
+                    if (procs.count() > 0 && memory_budget > 0) {
+                        u64 running_memory = 0;
+                        for (usize i = 0; i < count; ++i) running_memory += states[i].running_memory;
+                        if (running_memory + targets[index]->predict_job_memory(state, job) > memory_budget) break;
+                    }
+                    if (!procs.reserve_slot() && !has_free_remote_slot(state)) break;
+                    ++next_job[index];
+                    // Local processes of other targets take slots of the same pool
+                    u32 other_local_running = 0;
+                    for (usize i = 0; i < count; ++i)
+                        if (i != index) other_local_running += states[i].local_running;
+                    state.local_slots = max_procs > other_local_running ? (u32)max_procs - other_local_running : 0;
+                    auto proc = targets[index]->execute_compile_job(state, job, procs);
+                    if (proc.id == INVALID_PROCESS) {
+                        failed = true;
+                        break;
+                    }
+                    jobs.push(GraphJob{proc.id, index, false});
+                    ++running_compiles[index];
+                }
+            }
+            if (failed || procs.count() == 0) break;
+
+            Process finished;
+            bool success;
+            {
+                ScopedLogger _(logger_muted);
+                success = procs.wait_any(&finished);
+            }
+            for (usize i = 0; i < jobs.count(); ++i) {
+                if (jobs[i].id != finished.id) continue;
+                const auto job = jobs[i];
+                jobs.remove_unordered(i);
+                if (job.is_link) {
+                    if (has_trace) trace.end(finished);
+                    targets[job.target]->finish_link(states[job.target], success);
+                    if (success) stages[job.target] = TargetStage::DONE;
+                } else {
+                    targets[job.target]->finish_compile_job(states[job.target], finished);
+                    --running_compiles[job.target];
+                }
+                break;
+            }
+            if (!success) failed = true;
+        }
+        procs.wait_all();
+        for (usize i = 0; i < count; ++i) {
+            if (stages[i] != TargetStage::DONE) failed = true;
+            // Trace is most useful, when build failed or took long, so it's written in any case
+            const auto trace_file = targets[i]->_trace_file;
+            bool is_written = trace_file.size == 0;
+            for (usize j = 0; j < i && !is_written; ++j)
+                is_written = targets[j]->_trace_file == trace_file;
+            if (!is_written) trace.write(trace_file);
+        }
+        for (usize i = 0; i < count; ++i) {
+            targets[i]->clear();
+            states[i].~BuildState();
+        }
+        if (failed) log_error("Build of targets failed\n");
+        return !failed;
+    }
+
     void Cmd::reset()
     {
         _count = 0;
@@ -2359,13 +6540,34 @@ namespace Sl
         custom_flags.set_count(0);
         custom_arguments.set_count(0);
         defines.set_count(0);
+        unity_excluded_files.set_count(0);
+        remote_workers.set_count(0);
+        remote_worker_secrets.set_count(0);
+        forget_created_folders();
         _build_started = false;
         output_contains_ext = false;
+        is_cpp = true;
+        executable_type = FlagsExecutableType::EXECUTABLE;
+        thin_archive = false;
         incremental_build = true;
+        single_pass_dependencies = false;
+        content_hash = false;
+        unity_build = false;
+        unity_batches = 0;
+        time_trace = false;
         output_name = {"a", 1, true, false};
         _output_folder = {".build", 6, true, false};
         max_concurrent_processes = 0;
+        memory_budget = 0;
         _custom_compiler = "";
+        _object_cache_folder = "";
+        _precompiled_header = "";
+        _trace_file = "";
+    }
+
+    u64 Cmd::get_command_fingerprint() const
+    {
+        return hasher_fn_default(0, _data, _count);
     }
 
     void Cmd::print()
@@ -2507,6 +6709,142 @@ namespace Sl
         }
     }
 
+    // Implementation of ezbuild (with Sl) is compiled once into object in user cache folder, and then it's linked into
+    //  rebuilt build scripts, so only build script itself is compiled. Object is identified by compiler, build flags,
+    //  configuration macros of the build script (#define EZBUILD_.. and SL_..) and content of both headers.
+    //  Returns false, if it's not possible, then build script is compiled together with implementation. Macros are
+    //  copied line by line, so if they are defined conditionally, on multiple lines or undefined, it's not possible either.
+    static bool get_cached_implementation(Cmd& cmd, StrView script_path, StrBuilder& object_out)
+    {
+        ScopedLogger _(logger_muted);
+        StrBuilder script(get_global_allocator());
+        if (!read_entire_file(script_path, script)) return false;
+        StrBuilder source(get_global_allocator());
+        source.append("// Generated by rebuild_itself(), it's compiled once and linked into build scripts\n");
+        auto script_view = script.to_string_view();
+        usize conditional_depth = 0;
+        while (script_view.size > 0) {
+            auto line = script_view.chop_left_by_delimeter("\n");
+            line.trim_right_char('\n');
+            line.trim_right_char('\r');
+            line.trim();
+            if (!line.starts_with("#")) continue;
+            auto directive = line;
+            directive.chop_left(1);
+            directive.trim_left();
+            if (directive.starts_with("if")) ++conditional_depth; // #if, #ifdef and #ifndef
+            if (directive.starts_with("endif") && conditional_depth > 0) --conditional_depth;
+            const bool is_undef = directive.starts_with("undef");
+            if (!directive.starts_with("define") && !is_undef) continue;
+            directive.chop_left(is_undef ? 5 : 6);
+            directive.trim_left();
+            if (directive.starts_with("EZBUILD_NO_CACHED_IMPLEMENTATION")) return false;
+            if (!directive.starts_with("EZBUILD_") && !directive.starts_with("SL_")) continue;
+            auto name = directive;
+            const auto name_end = name.find_first_of_chars(" \t(");
+            if (name_end != StrView::INVALID_INDEX) name.chop_right(name.size - name_end);
+            if (name == "EZBUILD_IMPLEMENTATION") continue;
+            // Copied line wouldn't be the configuration, that script's declarations are compiled with
+            if (is_undef || conditional_depth > 0 || line.ends_with("\\")) return false;
+            source.append(line);
+            source.append('\n');
+        }
+        // Headers are found next to this one, build script runs from its folder, so __FILE__ is valid path
+        StrBuilder header_path(get_global_allocator());
+        if (!get_absolute_path(__FILE__, header_path)) return false;
+        auto header_view = header_path.to_string_view();
+        source.append("#define EZBUILD_IMPLEMENTATION\n#include \"");
+        source.append(header_view);
+        source.append("\"\n");
+
+        const auto compiler = cmd.get_effective_compiler();
+        const auto mark = cmd.count();
+        cmd.append_custom_flags();
+        cmd.append_defines();
+        u64 key = hasher_fn_default(0, cmd.data(), cmd.count());
+        StrView compiler_name(cmd.data(), cmd.count());
+        compiler_name.trim_left();
+        const auto space_index = compiler_name.find_first(' ');
+        if (space_index != StrView::INVALID_INDEX) compiler_name.chop_right(compiler_name.size - space_index);
+        key = hasher_fn_default(key, source.data(), source.count());
+        auto folder_end = header_view.find_last_of_chars("/\\");
+        StrBuilder sl_path(get_global_allocator());
+        sl_path.append(header_view.data, folder_end == StrView::INVALID_INDEX ? 0 : folder_end + 1);
+        sl_path.append("Sl.hpp");
+        sl_path.append_null(false);
+        const StrView headers[] = {header_path.to_string_view(), sl_path.to_string_view(true)};
+        for (auto& header : headers) {
+            StrBuilder content(get_global_allocator());
+            if (!read_entire_file(header, content)) {
+                cmd.set_count(mark);
+                return false;
+            }
+            key = hasher_fn_default(key, content.data(), content.count());
+        }
+
+        // $XDG_CACHE_HOME/ezbuild/<compiler> or %LOCALAPPDATA%/ezbuild/<compiler>, every folder is created if needed
+        StrBuilder folder(get_global_allocator());
+    #if defined(_WIN32)
+        const char* cache_home = getenv("LOCALAPPDATA");
+        if (cache_home) folder.append(cache_home);
+    #else
+        const char* cache_home = getenv("XDG_CACHE_HOME");
+        if (cache_home && cache_home[0] != '\0') {
+            folder.append(cache_home);
+        } else if ((cache_home = getenv("HOME")) != nullptr) {
+            folder.append(cache_home);
+            folder.append("/.cache");
+        }
+    #endif // !_WIN32
+        if (folder.count() == 0) {
+            cmd.set_count(mark);
+            return false;
+        }
+        auto compiler_file_name = compiler_name;
+        const auto slash_index = compiler_file_name.find_last_of_chars("/\\");
+        if (slash_index != StrView::INVALID_INDEX) compiler_file_name.chop_left(slash_index + 1);
+        const StrView sub_folders[] = {"", "/ezbuild/", compiler_file_name};
+        for (auto& sub_folder : sub_folders) {
+            folder.append(sub_folder);
+            folder.append_null(false);
+            create_folder(folder.to_string_view(true));
+        }
+        const u64 compiler_identity = get_compiler_identity(compiler_name, compiler, folder.to_string_view(true));
+        key = hasher_fn_default(key, &compiler_identity, sizeof(compiler_identity));
+
+        object_out.appendf(SB_FORMAT "/ezbuild-%016llx%s", SB_ARG(folder), (unsigned long long)key, compiler == FlagsCompiler::MSVC ? ".obj" : ".o");
+        object_out.append_null(false);
+        if (is_file_exists(object_out.to_string_view(true))) {
+            cmd.set_count(mark);
+            return true;
+        }
+        StrBuilder source_path(get_global_allocator());
+        StrBuilder temp_path(get_global_allocator());
+        source_path.appendf(SB_FORMAT "/ezbuild-%016llx.cpp", SB_ARG(folder), (unsigned long long)key);
+        source_path.append_null(false);
+        // Build scripts may compile it at the same time, object is renamed to its place when it's complete
+        temp_path.appendf(SB_FORMAT ".%llu.tmp", SB_ARG(object_out), (unsigned long long)get_current_process_id());
+        temp_path.append_null(false);
+        if (!write_to_file(source_path.to_string_view(true), source.data(), source.count())) {
+            cmd.set_count(mark);
+            return false;
+        }
+        cmd.append(compiler == FlagsCompiler::MSVC ? "/c " : "-c ");
+        cmd.append(source_path.to_string_view());
+        cmd.append(' ');
+        cmd.push_flag_output(compiler, true);
+        cmd.append(temp_path.to_string_view());
+        CmdOptions options = {};
+        options.reset_command = false;
+        const bool compiled = cmd.execute(options).exit_code == 0;
+        cmd.set_count(mark);
+        if (!compiled || !rename_file(temp_path.to_string_view(true), object_out.to_string_view(true))) {
+            delete_file(temp_path.to_string_view(true));
+            return false;
+        }
+        return true;
+    }
+
     bool was_script_rebuilt(int argc, char** argv)
     {
         if (argv == nullptr) return false;
@@ -2556,7 +6894,30 @@ namespace Sl
         SetConsoleOutputCP(CP_UTF8);
     #endif // !EZBUILD_DONT_SET_CONSOLE && _WIN32
 
-        auto needs_rebuilt_executable = file_needs_rebuilt(executable_name, source_paths);
+        // Dependency file of build script is kept in default output folder of Cmd with other build artefacts
+        const StrView dependency_folder = ".build";
+        StrView script_name = source_path;
+        const auto slash_index = script_name.find_last_of_chars("/\\");
+        if (slash_index != StrView::INVALID_INDEX) script_name.chop_left(slash_index + 1);
+
+        FileStatCache stat_cache;
+        auto needs_rebuilt_executable = file_needs_rebuilt(executable_name, source_paths, &stat_cache);
+        if (!force && needs_rebuilt_executable == Result::SL_FALSE) {
+            // Headers, that build script includes (listed or not), are taken from dependency file of its last compile.
+            //  Missing header means that includes were changed
+            ScopedLogger _(logger_muted);
+            Array<StrView> dependencies(get_global_allocator());
+            FileTimeUnit executable_time;
+            if (read_unescaped_dependencies(script_name, dependencies, dependency_folder, "") && stat_cache.get_time(executable_name, executable_time)) {
+                for (auto& dependency : dependencies) {
+                    FileTimeUnit dependency_time;
+                    if (!stat_cache.get_time(dependency, dependency_time) || compare_file_time(executable_time, dependency_time) < 0) {
+                        needs_rebuilt_executable = Result::SL_TRUE;
+                        break;
+                    }
+                }
+            }
+        }
         if (!force && needs_rebuilt_executable == Result::SL_FALSE) {
             source_paths.cleanup();
             temp_reset();
@@ -2599,8 +6960,27 @@ namespace Sl
         ScopedLogger _(logger_muted);
     #endif
         cmd.start_build(options);
+        StrBuilder implementation_object(get_global_allocator());
+        if (get_cached_implementation(cmd, source_path, implementation_object)) {
+            cmd.add_define("EZBUILD_IMPLEMENTATION_IS_LINKED");
+            cmd.add_source_file(implementation_object.to_string_view(true));
+        }
+        // Dependency file is read by the check above
+        StrBuilder dependency_path(get_global_allocator());
+        create_folder(dependency_folder);
+        get_dependency_path(dependency_path, script_name, get_compiler(), dependency_folder);
+        if (get_compiler() == FlagsCompiler::MSVC) {
+            cmd.add_cpp_flag("/sourceDependencies");
+        } else {
+            cmd.add_cpp_flag("-MMD");
+            cmd.add_cpp_flag("-MF");
+        }
+        cmd.add_cpp_flag(dependency_path.to_string_view(true));
         cmd.add_source_file(source_path);
         cmd.output_file(executable_name, true);
+    #if defined(_WIN32)
+        // Windows can't replace running process, rebuilt script runs as child process
+        UNUSED(system);
         for (auto& arg : saved_args) {
             cmd.add_run_argument(arg);
         }
@@ -2610,9 +6990,30 @@ namespace Sl
             rename_file(old_executable_name, executable_name);
             exit(EXIT_FAILURE);
         }
-        if (system != FlagsSystem::WINDOWS)
-            delete_file(old_executable_name);
         exit(EXIT_SUCCESS);
+    #else
+        if (!cmd.end_build(false)) {
+            rename_file(old_executable_name, executable_name);
+            exit(EXIT_FAILURE);
+        }
+        delete_file(old_executable_name);
+        // Rebuilt script replaces this process, so its exit code is the exit code of the build
+        StrBuilder executable_path(get_global_allocator());
+        if (!executable_name.contains('/')) executable_path.append("./");
+        executable_path.append(executable_name);
+        executable_path.append_null(false);
+        Array<char*> exec_args(get_global_allocator());
+        exec_args.push(executable_path.data());
+        for (auto& arg : saved_args)
+            exec_args.push((char*)arg.data); // Arguments point to argv
+        exec_args.push((char*)"EZBUILD_REBUILT");
+        exec_args.push((char*)nullptr);
+        fflush(stdout);
+        fflush(stderr);
+        execv(executable_path.data(), exec_args.data());
+        report_error("Could not execute rebuilt build script " SB_FORMAT, SB_ARG(executable_path));
+        exit(EXIT_FAILURE);
+    #endif // !_WIN32
     }
 } // namespace Sl
 #endif // EZBUILD_IMPLEMENTATION